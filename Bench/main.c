@@ -0,0 +1,524 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Cycle accurate benchmarks for the real firmware image. Loads the ELF built
+ * by the Atmel Studio project into simavr, plays a scripted session into PA7
+ * (IR receiver) and PB2 (button) and reports:
+ *
+ *   - cycles per call of selected functions, excluding time spent in ISRs
+ *   - latency from interrupt flag (or pin edge) to vector for each ISR
+ *   - error of each Timer1 input capture interval against the injected edges
+ *
+ * Usage: irthing_bench firmware.elf [-f function]...
+ *
+ * Static functions must survive in the ELF as symbols to be profiled (build
+ * with -fno-inline-small-functions or a Debug configuration).
+ */
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_irq.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/avr_ioport.h>
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _CPU_HZ 20000000UL
+#define _MCU "attiny84"
+#define _MAX_FUNCTIONS 16
+#define _MAX_DEPTH 32
+#define _VECTOR_SIZE 2
+#define _VECTOR_COUNT 17
+#define _NEC_ADDRESS 0x04
+#define _NEC_COMMAND 0x08
+
+// ATtiny84 data space addresses (I/O address + 0x20).
+#define _ICR1L  0x44
+#define _ICR1H  0x45
+#define _TCCR1B 0x4E
+#define _TIFR1  0x2B
+#define _TIFR0  0x58
+#define _GIFR   0x5A
+#define _SPL    0x5D
+#define _SPH    0x5E
+
+#define _MICROS(cycles) ((double)(cycles) * 1000000.0 / _CPU_HZ)
+
+static const char* _defaultFunctions[] = {
+    "_RunMode",
+    "ButtonGroupSample",
+    "_OnIndicatorFrameTimer",
+    "RunMachineTransitions",
+    "SetMachineStateWData",
+    "DrainRunLoop",
+    "TimerServiceAlarm",
+    "MachineLoop",
+};
+
+/**
+ * Which flag requests each vector. Vectors without a flag (INT0 in low
+ * level mode) are timed from the pin edge instead.
+ */
+static const struct
+{
+    const char* name;
+    uint8_t flagAddress;
+    uint8_t flagBit;
+} _vectors[_VECTOR_COUNT] = {
+    [1]  = { "INT0",       0,       0 },
+    [2]  = { "PCINT0",     _GIFR,   4 },
+    [3]  = { "PCINT1",     _GIFR,   5 },
+    [4]  = { "WDT",        0,       0 },
+    [5]  = { "TIM1_CAPT",  _TIFR1,  5 },
+    [6]  = { "TIM1_COMPA", _TIFR1,  1 },
+    [7]  = { "TIM1_COMPB", _TIFR1,  2 },
+    [8]  = { "TIM1_OVF",   _TIFR1,  0 },
+    [9]  = { "TIM0_COMPA", _TIFR0,  1 },
+    [10] = { "TIM0_COMPB", _TIFR0,  2 },
+    [11] = { "TIM0_OVF",   _TIFR0,  0 },
+};
+
+typedef struct _SamplesType
+{
+    uint32_t* values;
+    size_t count;
+    size_t capacity;
+} Samples;
+
+typedef struct _FunctionType
+{
+    const char* name;
+    uint32_t address;
+    Samples cycles;
+} Function;
+
+typedef struct _FrameType
+{
+    int16_t function;   /**< Index into functions, or -vector for an ISR. */
+    uint16_t sp;
+    avr_cycle_count_t start;
+    avr_cycle_count_t isrCyclesAtStart;
+} Frame;
+
+typedef struct _InputType
+{
+    avr_cycle_count_t at;
+    char port;
+    uint8_t pin;
+    uint8_t level;
+} Input;
+
+static struct
+{
+    avr_t* avr;
+    Function functions[_MAX_FUNCTIONS];
+    uint8_t functionCount;
+    Frame frames[_MAX_DEPTH];
+    uint8_t depth;
+    avr_cycle_count_t isrCycles;
+    Samples latency[_VECTOR_COUNT];
+    avr_cycle_count_t flagRaisedAt[_VECTOR_COUNT];
+    uint8_t lastFlags[_VECTOR_COUNT];
+    Input* inputs;
+    size_t inputCount;
+    size_t inputCapacity;
+    size_t nextInput;
+    avr_cycle_count_t lastButtonFall;
+    avr_cycle_count_t lastIrEdge;
+    avr_cycle_count_t prevIrEdge;
+    uint16_t prevCapture;
+    uint8_t hasPrevCapture;
+    Samples captureError;
+} _bench;
+
+// +--------------------------------------------------------------------------+
+// | SAMPLES
+// +--------------------------------------------------------------------------+
+static void _addSample(Samples* samples, uint32_t value)
+{
+    if (samples->count == samples->capacity)
+    {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 64;
+        samples->values = realloc(samples->values, samples->capacity * sizeof(uint32_t));
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int _compareSamples(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*)a;
+    const uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void _printSamples(const char* name, Samples* samples, uint8_t asMicros)
+{
+    if (!samples->count)
+    {
+        return;
+    }
+    qsort(samples->values, samples->count, sizeof(uint32_t), _compareSamples);
+    uint64_t total = 0;
+    for (size_t i = 0; i < samples->count; ++i)
+    {
+        total += samples->values[i];
+    }
+    const uint32_t median = samples->values[samples->count / 2];
+    const uint32_t p99 = samples->values[(samples->count * 99) / 100];
+    const double mean = (double)total / samples->count;
+    if (asMicros)
+    {
+        printf("  %-24s %8zu  min %8.2f  mean %8.2f  p50 %8.2f  p99 %8.2f  max %8.2f us\n", name, samples->count,
+               _MICROS(samples->values[0]), _MICROS(mean), _MICROS(median), _MICROS(p99),
+               _MICROS(samples->values[samples->count - 1]));
+    }
+    else
+    {
+        printf("  %-24s %8zu  min %8u  mean %8.1f  p50 %8u  p99 %8u  max %8u cycles\n", name, samples->count,
+               samples->values[0], mean, median, p99, samples->values[samples->count - 1]);
+    }
+}
+
+// +--------------------------------------------------------------------------+
+// | SYMBOLS
+// +--------------------------------------------------------------------------+
+/**
+ * Look up function addresses in the ELF's symbol table. simavr's own symbol
+ * support varies between versions so read it directly.
+ */
+static void _loadSymbols(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* image = malloc(size);
+    if (fread(image, 1, size, file) != (size_t)size)
+    {
+        size = 0;
+    }
+    fclose(file);
+
+    const Elf32_Ehdr* header = (const Elf32_Ehdr*)image;
+    if (size < (long)sizeof(Elf32_Ehdr) || memcmp(header->e_ident, ELFMAG, SELFMAG) || ELFCLASS32 != header->e_ident[EI_CLASS])
+    {
+        free(image);
+        return;
+    }
+    const Elf32_Shdr* sections = (const Elf32_Shdr*)(image + header->e_shoff);
+    for (uint16_t s = 0; s < header->e_shnum; ++s)
+    {
+        if (SHT_SYMTAB != sections[s].sh_type)
+        {
+            continue;
+        }
+        const Elf32_Sym* symbols = (const Elf32_Sym*)(image + sections[s].sh_offset);
+        const char* names = (const char*)(image + sections[sections[s].sh_link].sh_offset);
+        const size_t count = sections[s].sh_size / sizeof(Elf32_Sym);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (STT_FUNC != ELF32_ST_TYPE(symbols[i].st_info))
+            {
+                continue;
+            }
+            for (uint8_t f = 0; f < _bench.functionCount; ++f)
+            {
+                if (!strcmp(_bench.functions[f].name, names + symbols[i].st_name))
+                {
+                    _bench.functions[f].address = symbols[i].st_value;
+                }
+            }
+        }
+    }
+    free(image);
+}
+
+// +--------------------------------------------------------------------------+
+// | SCRIPT
+// +--------------------------------------------------------------------------+
+static avr_cycle_count_t _millis(uint32_t millis)
+{
+    return (avr_cycle_count_t)millis * (_CPU_HZ / 1000UL);
+}
+
+static avr_cycle_count_t _micros(uint32_t micros)
+{
+    return (avr_cycle_count_t)micros * (_CPU_HZ / 1000000UL);
+}
+
+static void _scheduleInput(avr_cycle_count_t at, char port, uint8_t pin, uint8_t level)
+{
+    if (_bench.inputCount == _bench.inputCapacity)
+    {
+        _bench.inputCapacity = _bench.inputCapacity ? _bench.inputCapacity * 2 : 256;
+        _bench.inputs = realloc(_bench.inputs, _bench.inputCapacity * sizeof(Input));
+    }
+    _bench.inputs[_bench.inputCount++] = (Input){ at, port, pin, level };
+}
+
+static avr_cycle_count_t _scheduleMark(avr_cycle_count_t at, uint32_t markMicros, uint32_t spaceMicros)
+{
+    // The receiver output is active low.
+    _scheduleInput(at, 'A', 7, 0);
+    at += _micros(markMicros);
+    _scheduleInput(at, 'A', 7, 1);
+    return at + _micros(spaceMicros);
+}
+
+static avr_cycle_count_t _scheduleNecFrame(avr_cycle_count_t at, uint8_t address, uint8_t command)
+{
+    const uint32_t data = (uint32_t)address | ((uint32_t)(uint8_t)~address << 8) |
+                          ((uint32_t)command << 16) | ((uint32_t)(uint8_t)~command << 24);
+    at = _scheduleMark(at, 9000, 4500);
+    for (uint8_t bit = 0; bit < 32; ++bit)
+    {
+        at = _scheduleMark(at, 560, (data & (1UL << bit)) ? 1690 : 560);
+    }
+    return _scheduleMark(at, 560, 40000);
+}
+
+static avr_cycle_count_t _scheduleClick(avr_cycle_count_t at, uint32_t heldMillis)
+{
+    _scheduleInput(at, 'B', 2, 0);
+    at += _millis(heldMillis);
+    _scheduleInput(at, 'B', 2, 1);
+    // Clicks are only dispatched once no second click can follow
+    // (GESTURE_MULTICLICK_MILLIS after the release).
+    return at + _millis(500);
+}
+
+/**
+ * The same session irthing_sim runs on the host simulator.
+ * \return When the session ends.
+ */
+static avr_cycle_count_t _scheduleSession(void)
+{
+    avr_cycle_count_t at = _millis(1000);
+    at = _scheduleClick(at, 50);
+    for (uint8_t frame = 0; frame < 20; ++frame)
+    {
+        at = _scheduleNecFrame(at, _NEC_ADDRESS, _NEC_COMMAND);
+    }
+    at = _scheduleClick(at, 50);
+    at = _scheduleNecFrame(at, _NEC_ADDRESS, _NEC_COMMAND);
+    at = _scheduleClick(at + _millis(1500), 50);
+    at += _millis(1000);
+    at = _scheduleClick(at, 2000);
+    return at + _millis(2000);
+}
+
+static avr_cycle_count_t _onInputTimer(avr_t* avr, avr_cycle_count_t when, void* param)
+{
+    while (_bench.nextInput < _bench.inputCount && _bench.inputs[_bench.nextInput].at <= when)
+    {
+        const Input* input = &_bench.inputs[_bench.nextInput++];
+        if ('A' == input->port && 7 == input->pin)
+        {
+            _bench.prevIrEdge = _bench.lastIrEdge;
+            _bench.lastIrEdge = avr->cycle;
+        }
+        else if ('B' == input->port && 2 == input->pin && !input->level)
+        {
+            _bench.lastButtonFall = avr->cycle;
+        }
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(input->port), input->pin), input->level);
+    }
+    return (_bench.nextInput < _bench.inputCount) ? _bench.inputs[_bench.nextInput].at : 0;
+}
+
+// +--------------------------------------------------------------------------+
+// | TRACING
+// +--------------------------------------------------------------------------+
+static uint16_t _stackPointer(avr_t* avr)
+{
+    return avr->data[_SPL] | (avr->data[_SPH] << 8);
+}
+
+static void _pushFrame(int16_t function, uint16_t sp, avr_cycle_count_t now)
+{
+    if (_bench.depth < _MAX_DEPTH)
+    {
+        _bench.frames[_bench.depth++] = (Frame){ function, sp, now, _bench.isrCycles };
+    }
+}
+
+static void _popFrames(avr_t* avr)
+{
+    const uint16_t sp = _stackPointer(avr);
+    while (_bench.depth && sp > _bench.frames[_bench.depth - 1].sp)
+    {
+        const Frame* frame = &_bench.frames[--_bench.depth];
+        const avr_cycle_count_t cycles = avr->cycle - frame->start;
+        if (frame->function < 0)
+        {
+            // Only count the outermost ISR so nested ones aren't doubled.
+            uint8_t isNested = 0;
+            for (uint8_t i = 0; i < _bench.depth; ++i)
+            {
+                isNested |= (_bench.frames[i].function < 0);
+            }
+            if (!isNested)
+            {
+                _bench.isrCycles += cycles;
+            }
+        }
+        else
+        {
+            const avr_cycle_count_t isrCycles = _bench.isrCycles - frame->isrCyclesAtStart;
+            _addSample(&_bench.functions[frame->function].cycles, (uint32_t)(cycles - isrCycles));
+        }
+    }
+}
+
+static void _watchFlags(avr_t* avr)
+{
+    for (uint8_t vector = 1; vector < _VECTOR_COUNT; ++vector)
+    {
+        if (!_vectors[vector].flagAddress)
+        {
+            continue;
+        }
+        const uint8_t isSet = (avr->data[_vectors[vector].flagAddress] >> _vectors[vector].flagBit) & 1;
+        if (isSet && !_bench.lastFlags[vector])
+        {
+            _bench.flagRaisedAt[vector] = avr->cycle;
+            if (5 == vector)
+            {
+                // Input capture. Compare the latched interval with the injected one.
+                const uint16_t capture = avr->data[_ICR1L] | (avr->data[_ICR1H] << 8);
+                static const uint16_t prescales[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+                const uint16_t prescale = prescales[avr->data[_TCCR1B] & 0x07];
+                const avr_cycle_count_t truth = _bench.lastIrEdge - _bench.prevIrEdge;
+                if (_bench.hasPrevCapture && prescale && truth < (avr_cycle_count_t)prescale << 16)
+                {
+                    const int64_t measured = (int64_t)(uint16_t)(capture - _bench.prevCapture) * prescale;
+                    const int64_t error = measured - (int64_t)truth;
+                    _addSample(&_bench.captureError, (uint32_t)(error < 0 ? -error : error));
+                }
+                _bench.prevCapture = capture;
+                _bench.hasPrevCapture = 1;
+            }
+        }
+        _bench.lastFlags[vector] = isSet;
+    }
+}
+
+static void _trace(avr_t* avr)
+{
+    const uint32_t pc = avr->pc;
+    if (pc < _VECTOR_COUNT * _VECTOR_SIZE && !(pc % _VECTOR_SIZE) && pc)
+    {
+        const uint8_t vector = pc / _VECTOR_SIZE;
+        const avr_cycle_count_t raisedAt = _vectors[vector].flagAddress ? _bench.flagRaisedAt[vector] : _bench.lastButtonFall;
+        if (raisedAt)
+        {
+            _addSample(&_bench.latency[vector], (uint32_t)(avr->cycle - raisedAt));
+        }
+        _pushFrame(-(int16_t)vector, _stackPointer(avr), avr->cycle);
+        return;
+    }
+    for (uint8_t f = 0; f < _bench.functionCount; ++f)
+    {
+        if (_bench.functions[f].address && pc == _bench.functions[f].address)
+        {
+            _pushFrame(f, _stackPointer(avr), avr->cycle);
+        }
+    }
+}
+
+// +--------------------------------------------------------------------------+
+// | MAIN
+// +--------------------------------------------------------------------------+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s firmware.elf [-f function]...\n", argv[0]);
+        return 2;
+    }
+    for (int i = 2; i + 1 < argc && _bench.functionCount < _MAX_FUNCTIONS; i += 2)
+    {
+        if (!strcmp(argv[i], "-f"))
+        {
+            _bench.functions[_bench.functionCount++].name = argv[i + 1];
+        }
+    }
+    if (!_bench.functionCount)
+    {
+        for (size_t i = 0; i < sizeof(_defaultFunctions) / sizeof(_defaultFunctions[0]); ++i)
+        {
+            _bench.functions[_bench.functionCount++].name = _defaultFunctions[i];
+        }
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[1], &firmware))
+    {
+        fprintf(stderr, "could not read %s\n", argv[1]);
+        return 1;
+    }
+    _loadSymbols(argv[1]);
+
+    avr_t* avr = avr_make_mcu_by_name(_MCU);
+    if (!avr)
+    {
+        fprintf(stderr, "simavr has no %s core\n", _MCU);
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = _CPU_HZ;
+    _bench.avr = avr;
+
+    const avr_cycle_count_t end = _scheduleSession();
+    avr_cycle_timer_register(avr, _bench.inputs[0].at, _onInputTimer, 0);
+
+    int state = cpu_Running;
+    while (avr->cycle < end && cpu_Done != state && cpu_Crashed != state)
+    {
+        _trace(avr);
+        state = avr_run(avr);
+        _watchFlags(avr);
+        _popFrames(avr);
+    }
+    if (cpu_Crashed == state)
+    {
+        fprintf(stderr, "firmware crashed at pc 0x%04x\n", avr->pc);
+    }
+
+    printf("%.2f simulated seconds, %zu input edges\n\n", (double)avr->cycle / _CPU_HZ, _bench.nextInput);
+    printf("function cycles (excluding ISRs):\n");
+    for (uint8_t f = 0; f < _bench.functionCount; ++f)
+    {
+        if (!_bench.functions[f].address)
+        {
+            printf("  %-24s not in the ELF (inlined or unused)\n", _bench.functions[f].name);
+        }
+        _printSamples(_bench.functions[f].name, &_bench.functions[f].cycles, 0);
+    }
+    printf("\nISR latency (flag or pin edge to vector):\n");
+    for (uint8_t vector = 1; vector < _VECTOR_COUNT; ++vector)
+    {
+        if (_vectors[vector].name)
+        {
+            _printSamples(_vectors[vector].name, &_bench.latency[vector], 1);
+        }
+    }
+    printf("\ncapture interval error against injected edges:\n");
+    _printSamples("TIM1_CAPT", &_bench.captureError, 1);
+
+    avr_terminate(avr);
+    return (cpu_Crashed == state) ? 1 : 0;
+}
@@ -0,0 +1,913 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "HostSim.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define _NEVER UINT64_MAX
+#define _AWAKE 0xFF
+#define _STACK_SIZE (256 * 1024)
+#define _SEI_CYCLES 1
+#define _EEPROM_WRITE_MICROS 3400
+#define _WDT_HZ 128000UL
+
+#define _TIMER0 0
+#define _TIMER1 1
+
+// +--------------------------------------------------------------------------+
+// | REGISTERS
+// +--------------------------------------------------------------------------+
+volatile uint8_t PORTA;
+volatile uint8_t DDRA;
+volatile uint8_t PORTB;
+volatile uint8_t DDRB;
+volatile uint8_t TCCR0A;
+volatile uint8_t TCCR0B;
+volatile uint8_t TIMSK0;
+volatile uint8_t TIFR0;
+volatile uint8_t OCR0A;
+volatile uint8_t OCR0B;
+volatile uint8_t TCNT0;
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint8_t TCCR1C;
+volatile uint8_t TIMSK1;
+volatile uint8_t TIFR1;
+volatile uint16_t TCNT1;
+volatile uint16_t OCR1A;
+volatile uint16_t OCR1B;
+volatile uint16_t ICR1;
+volatile uint8_t GIMSK;
+volatile uint8_t GIFR;
+volatile uint8_t PCMSK0;
+volatile uint8_t PCMSK1;
+volatile uint8_t MCUCR;
+volatile uint8_t MCUSR;
+volatile uint8_t PRR;
+volatile uint8_t ACSR;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint8_t DIDR0;
+volatile uint8_t SREG;
+volatile uint8_t WDTCSR;
+volatile uint8_t CLKPR;
+volatile uint8_t OSCCAL;
+volatile uint8_t GPIOR0;
+volatile uint8_t GPIOR1;
+volatile uint8_t GPIOR2;
+volatile uint8_t EECR;
+volatile uint8_t EEARL;
+volatile uint8_t EEDR;
+
+// +--------------------------------------------------------------------------+
+// | DEFAULT VECTORS
+// +--------------------------------------------------------------------------+
+#define _WEAK_VECTOR(vector) __attribute__((weak)) void vector(void) {}
+_WEAK_VECTOR(INT0_vect)
+_WEAK_VECTOR(PCINT0_vect)
+_WEAK_VECTOR(PCINT1_vect)
+_WEAK_VECTOR(WDT_vect)
+_WEAK_VECTOR(TIM1_CAPT_vect)
+_WEAK_VECTOR(TIM1_COMPA_vect)
+_WEAK_VECTOR(TIM1_COMPB_vect)
+_WEAK_VECTOR(TIM1_OVF_vect)
+_WEAK_VECTOR(TIM0_COMPA_vect)
+_WEAK_VECTOR(TIM0_COMPB_vect)
+_WEAK_VECTOR(TIM0_OVF_vect)
+
+extern char __start_hostsim_eeprom[] __attribute__((weak));
+
+typedef void (*_VectorFunc)(void);
+
+typedef struct _InputType
+{
+    HostSimCycles at;
+    uint8_t port;
+    uint8_t pin;
+    uint8_t level;
+} _Input;
+
+/**
+ * A snapshot of one timer's registers in a form both timers share.
+ */
+typedef struct _TimerViewType
+{
+    uint16_t count;
+    uint16_t top;
+    uint16_t max;
+    uint16_t compareA;
+    uint16_t compareB;
+    uint8_t isTovAtTop;
+    uint8_t flags;
+} _TimerView;
+
+static struct
+{
+    HostSimCycles now;
+    HostSimCycles deadline;
+    HostSimCycles wdtElapsed;
+    uint32_t cpuHz;
+    uint32_t timerPhase[2];
+    uint8_t division;
+    uint8_t sleepMode;
+    uint8_t isAlive;
+    uint8_t isSeiPending;
+    uint8_t wasWatchdogReset;
+    uint8_t inputs[2];
+    uint8_t driven[2];
+    _Input* queue;
+    size_t queueHead;
+    size_t queueLength;
+    size_t queueCapacity;
+    ucontext_t hostContext;
+    ucontext_t firmwareContext;
+    void* stack;
+    HostSimEntryFunc entry;
+    HostSimOutputFunc observer;
+    HostSimStats stats;
+    uint8_t eeprom[E2END + 1];
+    uint8_t isEepromInitialized;
+} _sim;
+
+// +--------------------------------------------------------------------------+
+// | TIMERS
+// +--------------------------------------------------------------------------+
+static uint32_t _timerPrescale(uint8_t timer)
+{
+    const uint8_t clockSelect = (_TIMER0 == timer) ? (TCCR0B & 0x07) : (TCCR1B & 0x07);
+    const uint8_t powerBit = (_TIMER0 == timer) ? _BV(PRTIM0) : _BV(PRTIM1);
+    if (PRR & powerBit)
+    {
+        return 0;
+    }
+    switch(clockSelect)
+    {
+        case 1: return 1;
+        case 2: return 8;
+        case 3: return 64;
+        case 4: return 256;
+        case 5: return 1024;
+        default: return 0; // Stopped or clocked from T0/T1 (not modeled).
+    }
+}
+
+static uint8_t _isTimer1IcrTop(void)
+{
+    const uint8_t mode = (TCCR1A & 0x03) | ((TCCR1B >> WGM12) & 0x03) << 2;
+    return (8 == mode || 10 == mode || 12 == mode || 14 == mode);
+}
+
+static void _loadTimer(uint8_t timer, _TimerView* view)
+{
+    view->flags = 0;
+    if (_TIMER0 == timer)
+    {
+        const uint8_t mode = (TCCR0A & 0x03) | ((TCCR0B >> WGM02) & 0x01) << 2;
+        view->count = TCNT0;
+        view->max = 0xFF;
+        view->compareA = OCR0A;
+        view->compareB = OCR0B;
+        view->top = (2 == mode || 5 == mode || 7 == mode) ? OCR0A : 0xFF;
+        view->isTovAtTop = (1 == mode || 3 == mode || 5 == mode || 7 == mode);
+    }
+    else
+    {
+        const uint8_t mode = (TCCR1A & 0x03) | ((TCCR1B >> WGM12) & 0x03) << 2;
+        view->count = TCNT1;
+        view->max = 0xFFFF;
+        view->compareA = OCR1A;
+        view->compareB = OCR1B;
+        switch(mode)
+        {
+            case 1: case 5: view->top = 0xFF; break;
+            case 2: case 6: view->top = 0x1FF; break;
+            case 3: case 7: view->top = 0x3FF; break;
+            case 4: case 9: case 11: case 15: view->top = OCR1A; break;
+            case 8: case 10: case 12: case 14: view->top = ICR1; break;
+            default: view->top = 0xFFFF; break;
+        }
+        view->isTovAtTop = !(0 == mode || 4 == mode || 12 == mode);
+    }
+}
+
+static void _storeTimer(uint8_t timer, const _TimerView* view)
+{
+    if (_TIMER0 == timer)
+    {
+        TCNT0 = view->count;
+        TIFR0 |= view->flags;
+    }
+    else
+    {
+        TCNT1 = view->count;
+        TIFR1 |= view->flags;
+    }
+}
+
+static uint32_t _ticksToEvent(const _TimerView* view)
+{
+    // A counter written past TOP runs on to MAX before wrapping.
+    const uint16_t top = (view->count > view->top) ? view->max : view->top;
+    const uint32_t wrap = (uint32_t)top - view->count + 1;
+    uint32_t ticks = wrap;
+    const uint16_t compares[2] = { view->compareA, view->compareB };
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        const uint16_t compare = compares[i];
+        if (compare <= top)
+        {
+            const uint32_t distance = (compare > view->count) ? compare - view->count : wrap + compare;
+            if (distance < ticks)
+            {
+                ticks = distance;
+            }
+        }
+    }
+    return ticks;
+}
+
+static void _advanceTimerTicks(_TimerView* view, uint32_t ticks)
+{
+    while (ticks)
+    {
+        const uint32_t next = _ticksToEvent(view);
+        if (ticks < next)
+        {
+            view->count += ticks;
+            return;
+        }
+        ticks -= next;
+        const uint16_t top = (view->count > view->top) ? view->max : view->top;
+        if ((uint32_t)top - view->count + 1 == next)
+        {
+            view->count = 0;
+            if (view->isTovAtTop || top == view->max)
+            {
+                view->flags |= _BV(TOV0);
+            }
+        }
+        else
+        {
+            view->count += next;
+        }
+        if (view->count == view->compareA)
+        {
+            view->flags |= _BV(OCF0A);
+        }
+        if (view->count == view->compareB)
+        {
+            view->flags |= _BV(OCF0B);
+        }
+    }
+}
+
+/**
+ * \return System clock cycles until the timer next sets a flag or _NEVER.
+ */
+static HostSimCycles _cyclesToTimerEvent(uint8_t timer)
+{
+    const uint32_t prescale = _timerPrescale(timer);
+    if (!prescale)
+    {
+        return _NEVER;
+    }
+    _TimerView view;
+    _loadTimer(timer, &view);
+    const HostSimCycles period = (HostSimCycles)prescale << _sim.division;
+    return _ticksToEvent(&view) * period - _sim.timerPhase[timer];
+}
+
+static void _advanceTimer(uint8_t timer, HostSimCycles cycles)
+{
+    const uint32_t prescale = _timerPrescale(timer);
+    if (!prescale)
+    {
+        return;
+    }
+    const HostSimCycles period = (HostSimCycles)prescale << _sim.division;
+    const HostSimCycles total = _sim.timerPhase[timer] + cycles;
+    _sim.timerPhase[timer] = total % period;
+    if (total >= period)
+    {
+        _TimerView view;
+        _loadTimer(timer, &view);
+        _advanceTimerTicks(&view, total / period);
+        _storeTimer(timer, &view);
+    }
+}
+
+// +--------------------------------------------------------------------------+
+// | WATCHDOG
+// +--------------------------------------------------------------------------+
+static HostSimCycles _watchdogTimeout(void)
+{
+    if (!(WDTCSR & (_BV(WDE) | _BV(WDIE))))
+    {
+        return _NEVER;
+    }
+    uint8_t prescale = (WDTCSR & 0x07) | ((WDTCSR & _BV(WDP3)) ? 0x08 : 0);
+    if (prescale > 9)
+    {
+        prescale = 9;
+    }
+    return ((HostSimCycles)2048 << prescale) * _sim.cpuHz / _WDT_HZ;
+}
+
+static void _advanceWatchdog(HostSimCycles cycles)
+{
+    const HostSimCycles timeout = _watchdogTimeout();
+    if (_NEVER == timeout)
+    {
+        _sim.wdtElapsed = 0;
+        return;
+    }
+    _sim.wdtElapsed += cycles;
+    if (_sim.wdtElapsed < timeout)
+    {
+        return;
+    }
+    _sim.wdtElapsed = 0;
+    if (WDTCSR & _BV(WDIE))
+    {
+        WDTCSR |= _BV(WDIF);
+        if (WDTCSR & _BV(WDE))
+        {
+            // Interrupt and system reset mode. The next timeout resets.
+            WDTCSR &= ~_BV(WDIE);
+        }
+    }
+    else
+    {
+        _sim.wasWatchdogReset = 1;
+        _sim.isAlive = 0;
+    }
+}
+
+// +--------------------------------------------------------------------------+
+// | PINS
+// +--------------------------------------------------------------------------+
+static uint8_t _drivenLevels(uint8_t port)
+{
+    if (HOSTSIM_PORTB == port)
+    {
+        return PORTB & DDRB;
+    }
+    uint8_t driven = PORTA & DDRA;
+    if ((TCCR1A & (_BV(COM1B1) | _BV(COM1B0))) && (DDRA & _BV(PA5)))
+    {
+        // OC1B overrides the port while connected.
+        driven &= ~_BV(PA5);
+        if (_timerPrescale(_TIMER1))
+        {
+            driven |= _BV(PA5);
+        }
+    }
+    return driven;
+}
+
+static void _publishOutputs(void)
+{
+    for (uint8_t port = 0; port < 2; ++port)
+    {
+        const uint8_t driven = _drivenLevels(port);
+        if (driven != _sim.driven[port])
+        {
+            _sim.driven[port] = driven;
+            if (_sim.observer)
+            {
+                _sim.observer(_sim.now, port, driven);
+            }
+        }
+    }
+}
+
+static void _applyInput(const _Input* input)
+{
+    const uint8_t mask = _BV(input->pin);
+    const uint8_t wasHigh = (_sim.inputs[input->port] & mask) ? 1 : 0;
+    if (wasHigh == input->level)
+    {
+        return;
+    }
+    _sim.inputs[input->port] ^= mask;
+    ++_sim.stats.inputEdges;
+
+    if (HOSTSIM_PORTA == input->port)
+    {
+        if (PCMSK0 & mask)
+        {
+            GIFR |= _BV(PCIF0);
+        }
+        if (PA7 == input->pin && _timerPrescale(_TIMER1) && !_isTimer1IcrTop())
+        {
+            const uint8_t isRising = input->level;
+            if (isRising == ((TCCR1B & _BV(ICES1)) ? 1 : 0))
+            {
+                ICR1 = TCNT1;
+                TIFR1 |= _BV(ICF1);
+            }
+        }
+    }
+    else
+    {
+        if (PCMSK1 & mask)
+        {
+            GIFR |= _BV(PCIF1);
+        }
+        if (PB2 == input->pin)
+        {
+            switch(MCUCR & (_BV(ISC01) | _BV(ISC00)))
+            {
+                case _BV(ISC00):
+                    GIFR |= _BV(INTF0);
+                    break;
+                case _BV(ISC01):
+                    GIFR |= input->level ? 0 : _BV(INTF0);
+                    break;
+                case _BV(ISC01) | _BV(ISC00):
+                    GIFR |= input->level ? _BV(INTF0) : 0;
+                    break;
+            }
+        }
+    }
+}
+
+static void _applyInputs(void)
+{
+    while (_sim.queueHead < _sim.queueLength && _sim.queue[_sim.queueHead].at <= _sim.now)
+    {
+        _applyInput(&_sim.queue[_sim.queueHead++]);
+    }
+    if (_sim.queueHead == _sim.queueLength)
+    {
+        _sim.queueHead = 0;
+        _sim.queueLength = 0;
+    }
+}
+
+// +--------------------------------------------------------------------------+
+// | INTERRUPTS
+// +--------------------------------------------------------------------------+
+/**
+ * Find the highest priority pending interrupt and acknowledge it.
+ * \param  isWakeOnly   Only consider interrupts that can wake the MCU from
+ *                      power down (nothing is acknowledged).
+ */
+static _VectorFunc _pendingVector(uint8_t isWakeOnly)
+{
+    const uint8_t isLowLevel = !(MCUCR & (_BV(ISC01) | _BV(ISC00)));
+    if (GIMSK & _BV(INT0))
+    {
+        if (isLowLevel && !(HostSimReadPins(HOSTSIM_PORTB) & _BV(PB2)))
+        {
+            return INT0_vect;
+        }
+        if (!isLowLevel && (GIFR & _BV(INTF0)) && !isWakeOnly)
+        {
+            GIFR &= ~_BV(INTF0);
+            return INT0_vect;
+        }
+    }
+    if ((GIMSK & _BV(PCIE0)) && (GIFR & _BV(PCIF0)))
+    {
+        GIFR &= isWakeOnly ? 0xFF : ~_BV(PCIF0);
+        return PCINT0_vect;
+    }
+    if ((GIMSK & _BV(PCIE1)) && (GIFR & _BV(PCIF1)))
+    {
+        GIFR &= isWakeOnly ? 0xFF : ~_BV(PCIF1);
+        return PCINT1_vect;
+    }
+    if ((WDTCSR & _BV(WDIF)) && (WDTCSR & (_BV(WDIE) | _BV(WDE))))
+    {
+        WDTCSR &= isWakeOnly ? 0xFF : ~_BV(WDIF);
+        return WDT_vect;
+    }
+    if (isWakeOnly)
+    {
+        return 0;
+    }
+
+    static const struct
+    {
+        volatile uint8_t* flags;
+        volatile uint8_t* mask;
+        uint8_t bit;
+        _VectorFunc vector;
+    } timerVectors[] = {
+        { &TIFR1, &TIMSK1, ICF1, TIM1_CAPT_vect },
+        { &TIFR1, &TIMSK1, OCF1A, TIM1_COMPA_vect },
+        { &TIFR1, &TIMSK1, OCF1B, TIM1_COMPB_vect },
+        { &TIFR1, &TIMSK1, TOV1, TIM1_OVF_vect },
+        { &TIFR0, &TIMSK0, OCF0A, TIM0_COMPA_vect },
+        { &TIFR0, &TIMSK0, OCF0B, TIM0_COMPB_vect },
+        { &TIFR0, &TIMSK0, TOV0, TIM0_OVF_vect },
+    };
+    for (size_t i = 0; i < sizeof(timerVectors) / sizeof(timerVectors[0]); ++i)
+    {
+        const uint8_t bit = _BV(timerVectors[i].bit);
+        if ((*timerVectors[i].flags & bit) && (*timerVectors[i].mask & bit))
+        {
+            *timerVectors[i].flags &= ~bit;
+            return timerVectors[i].vector;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \return The number of interrupts serviced.
+ */
+static uint32_t _dispatch(void)
+{
+    uint32_t count = 0;
+    while (SREG & _BV(SREG_I))
+    {
+        const _VectorFunc vector = _pendingVector(0);
+        if (!vector)
+        {
+            break;
+        }
+        SREG &= ~_BV(SREG_I);
+        ++_sim.stats.interrupts;
+        ++count;
+        vector();
+        SREG |= _BV(SREG_I);
+        _publishOutputs();
+    }
+    return count;
+}
+
+static void _yield(void)
+{
+    swapcontext(&_sim.firmwareContext, &_sim.hostContext);
+}
+
+/**
+ * Move simulated time forward, servicing interrupts as they come due.
+ * \param  cycles     System clock cycles to advance by (ignored if sleeping).
+ * \param  sleepMode  _AWAKE or the SM bits of the sleep mode. Returns as soon
+ *                    as an interrupt wakes the MCU if sleeping.
+ */
+static void _advance(HostSimCycles cycles, uint8_t sleepMode)
+{
+    const HostSimCycles target = (_AWAKE == sleepMode) ? _sim.now + cycles : _NEVER;
+    _sim.sleepMode = sleepMode;
+    _sim.isSeiPending = 0;
+    while (1)
+    {
+        _publishOutputs();
+        if (!_sim.isAlive)
+        {
+            _yield();
+        }
+
+        if (SREG & _BV(SREG_I))
+        {
+            const uint8_t isClocked = (_AWAKE == _sim.sleepMode || SLEEP_MODE_IDLE == _sim.sleepMode);
+            if (!isClocked && _pendingVector(1))
+            {
+                _sim.sleepMode = SLEEP_MODE_IDLE;
+            }
+            if (_dispatch() && _AWAKE != sleepMode)
+            {
+                ++_sim.stats.wakeups;
+                _sim.sleepMode = _AWAKE;
+                return;
+            }
+        }
+
+        if (_sim.now >= _sim.deadline)
+        {
+            _yield();
+            continue;
+        }
+        if (_sim.now >= target)
+        {
+            _sim.sleepMode = _AWAKE;
+            return;
+        }
+
+        // Timers only run while the I/O clock does.
+        const uint8_t isClocked = (_AWAKE == _sim.sleepMode || SLEEP_MODE_IDLE == _sim.sleepMode);
+        HostSimCycles next = (target < _sim.deadline) ? target : _sim.deadline;
+        if (_sim.queueHead < _sim.queueLength && _sim.queue[_sim.queueHead].at < next)
+        {
+            next = (_sim.queue[_sim.queueHead].at > _sim.now) ? _sim.queue[_sim.queueHead].at : _sim.now;
+        }
+        if (isClocked)
+        {
+            for (uint8_t timer = _TIMER0; timer <= _TIMER1; ++timer)
+            {
+                const HostSimCycles event = _cyclesToTimerEvent(timer);
+                if (_NEVER != event && _sim.now + event < next)
+                {
+                    next = _sim.now + event;
+                }
+            }
+        }
+        const HostSimCycles timeout = _watchdogTimeout();
+        if (_NEVER != timeout && _sim.now + (timeout - _sim.wdtElapsed) < next)
+        {
+            next = _sim.now + (timeout - _sim.wdtElapsed);
+        }
+
+        const HostSimCycles elapsed = next - _sim.now;
+        if (isClocked)
+        {
+            _advanceTimer(_TIMER0, elapsed);
+            _advanceTimer(_TIMER1, elapsed);
+        }
+        _advanceWatchdog(elapsed);
+        _sim.now = next;
+        _applyInputs();
+    }
+}
+
+static void _runFirmware(void)
+{
+    _sim.entry();
+    _sim.isAlive = 0;
+}
+
+// +--------------------------------------------------------------------------+
+// | HOST API
+// +--------------------------------------------------------------------------+
+void HostSimStart(HostSimEntryFunc entry, uint32_t cpuHz)
+{
+    if (!_sim.isEepromInitialized)
+    {
+        memset(_sim.eeprom, 0xFF, sizeof(_sim.eeprom));
+        _sim.isEepromInitialized = 1;
+    }
+    if (!_sim.stack)
+    {
+        _sim.stack = malloc(_STACK_SIZE);
+    }
+
+    PORTA = DDRA = PORTB = DDRB = 0;
+    TCCR0A = TCCR0B = TIMSK0 = TIFR0 = OCR0A = OCR0B = TCNT0 = 0;
+    TCCR1A = TCCR1B = TCCR1C = TIMSK1 = TIFR1 = 0;
+    TCNT1 = OCR1A = OCR1B = ICR1 = 0;
+    GIMSK = GIFR = PCMSK0 = PCMSK1 = MCUCR = PRR = ACSR = 0;
+    ADCSRA = ADCSRB = DIDR0 = SREG = WDTCSR = CLKPR = 0;
+    _sim.isSeiPending = 0;
+    MCUSR = _sim.wasWatchdogReset ? _BV(WDRF) : _BV(PORF);
+
+    _sim.entry = entry;
+    _sim.cpuHz = cpuHz;
+    _sim.division = 0;
+    _sim.timerPhase[_TIMER0] = 0;
+    _sim.timerPhase[_TIMER1] = 0;
+    _sim.wdtElapsed = 0;
+    _sim.wasWatchdogReset = 0;
+    _sim.sleepMode = _AWAKE;
+    _sim.inputs[HOSTSIM_PORTA] = 0xFF;
+    _sim.inputs[HOSTSIM_PORTB] = 0xFF;
+    _sim.driven[HOSTSIM_PORTA] = 0;
+    _sim.driven[HOSTSIM_PORTB] = 0;
+    _sim.isAlive = 1;
+
+    getcontext(&_sim.firmwareContext);
+    _sim.firmwareContext.uc_stack.ss_sp = _sim.stack;
+    _sim.firmwareContext.uc_stack.ss_size = _STACK_SIZE;
+    _sim.firmwareContext.uc_link = &_sim.hostContext;
+    makecontext(&_sim.firmwareContext, _runFirmware, 0);
+}
+
+uint8_t HostSimRunUntil(HostSimCycles at)
+{
+    if (_sim.isAlive && at > _sim.now)
+    {
+        _sim.deadline = at;
+        swapcontext(&_sim.hostContext, &_sim.firmwareContext);
+    }
+    return _sim.isAlive;
+}
+
+HostSimCycles HostSimNow(void)
+{
+    return _sim.now;
+}
+
+HostSimCycles HostSimMillisToCycles(uint32_t millis)
+{
+    return (HostSimCycles)millis * (_sim.cpuHz / 1000UL);
+}
+
+HostSimCycles HostSimMicrosToCycles(uint32_t micros)
+{
+    return (HostSimCycles)micros * _sim.cpuHz / 1000000UL;
+}
+
+void HostSimScheduleInput(HostSimCycles at, uint8_t port, uint8_t pin, uint8_t level)
+{
+    if (_sim.queueLength == _sim.queueCapacity)
+    {
+        _sim.queueCapacity = _sim.queueCapacity ? _sim.queueCapacity * 2 : 256;
+        _sim.queue = realloc(_sim.queue, _sim.queueCapacity * sizeof(_Input));
+    }
+    _Input* input = &_sim.queue[_sim.queueLength++];
+    input->at = at;
+    input->port = port;
+    input->pin = pin;
+    input->level = level ? 1 : 0;
+}
+
+void HostSimSetOutputObserver(HostSimOutputFunc observer)
+{
+    _sim.observer = observer;
+}
+
+uint8_t HostSimIsSleeping(void)
+{
+    return (_AWAKE != _sim.sleepMode);
+}
+
+const HostSimStats* HostSimGetStats(void)
+{
+    return &_sim.stats;
+}
+
+// +--------------------------------------------------------------------------+
+// | FIRMWARE API
+// +--------------------------------------------------------------------------+
+uint8_t HostSimReadPins(uint8_t port)
+{
+    const uint8_t direction = (HOSTSIM_PORTA == port) ? DDRA : DDRB;
+    const uint8_t output = (HOSTSIM_PORTA == port) ? PORTA : PORTB;
+    return (output & direction) | (_sim.inputs[port] & ~direction);
+}
+
+void HostSimClearFlags(volatile uint8_t* reg, uint8_t flags)
+{
+    *reg &= ~flags;
+}
+
+void HostSimEnableInterrupts(void)
+{
+    // Pending interrupts are serviced by whatever the firmware does next.
+    SREG |= _BV(SREG_I);
+    _sim.isSeiPending = 1;
+}
+
+void HostSimDisableInterrupts(void)
+{
+    if (_sim.isSeiPending && (SREG & _BV(SREG_I)))
+    {
+        _advance((HostSimCycles)_SEI_CYCLES << _sim.division, _AWAKE);
+    }
+    SREG &= ~_BV(SREG_I);
+}
+
+uint8_t TinkerEnterCritical(void)
+{
+    const uint8_t sreg = SREG;
+    HostSimDisableInterrupts();
+    return sreg;
+}
+
+void TinkerExitCritical(uint8_t state)
+{
+    if (state & _BV(SREG_I))
+    {
+        HostSimEnableInterrupts();
+    }
+    else
+    {
+        HostSimDisableInterrupts();
+    }
+}
+
+void HostSimSleep(void)
+{
+    if (MCUCR & _BV(SE))
+    {
+        _advance(0, MCUCR & (_BV(SM1) | _BV(SM0)));
+    }
+}
+
+void HostSimDelayCycles(uint32_t cpuCycles)
+{
+    _advance((HostSimCycles)cpuCycles << _sim.division, _AWAKE);
+}
+
+void HostSimWatchdogReset(void)
+{
+    _sim.wdtElapsed = 0;
+}
+
+void HostSimSetClockDivision(uint8_t division)
+{
+    _sim.division = (division > 8) ? 8 : division;
+    CLKPR = _sim.division;
+}
+
+uint8_t HostSimGetClockDivision(void)
+{
+    return _sim.division;
+}
+
+uint8_t* HostSimEepromAddress(const void* address)
+{
+    const ptrdiff_t offset = (const char*)address - __start_hostsim_eeprom;
+    if (!__start_hostsim_eeprom || offset < 0 || offset > E2END)
+    {
+        fprintf(stderr, "HostSim: %p is not an EEMEM address\n", address);
+        abort();
+    }
+    return &_sim.eeprom[offset];
+}
+
+// +--------------------------------------------------------------------------+
+// | EEPROM
+// +--------------------------------------------------------------------------+
+static void _eepromWrite(uint8_t* address, uint8_t value, uint8_t isUpdate)
+{
+    uint8_t* cell = HostSimEepromAddress(address);
+    if (isUpdate && *cell == value)
+    {
+        return;
+    }
+    *cell = value;
+    ++_sim.stats.eepromWrites;
+    HostSimDelayCycles(HostSimMicrosToCycles(_EEPROM_WRITE_MICROS) >> _sim.division);
+}
+
+uint8_t eeprom_read_byte(const uint8_t* address)
+{
+    return *HostSimEepromAddress(address);
+}
+
+uint16_t eeprom_read_word(const uint16_t* address)
+{
+    uint16_t value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+uint32_t eeprom_read_dword(const uint32_t* address)
+{
+    uint32_t value;
+    eeprom_read_block(&value, address, sizeof(value));
+    return value;
+}
+
+void eeprom_read_block(void* destination, const void* source, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        ((uint8_t*)destination)[i] = *HostSimEepromAddress((const uint8_t*)source + i);
+    }
+}
+
+void eeprom_write_byte(uint8_t* address, uint8_t value)
+{
+    _eepromWrite(address, value, 0);
+}
+
+void eeprom_write_word(uint16_t* address, uint16_t value)
+{
+    eeprom_write_block(&value, address, sizeof(value));
+}
+
+void eeprom_write_block(const void* source, void* destination, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        _eepromWrite((uint8_t*)destination + i, ((const uint8_t*)source)[i], 0);
+    }
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+    _eepromWrite(address, value, 1);
+}
+
+void eeprom_update_word(uint16_t* address, uint16_t value)
+{
+    eeprom_update_block(&value, address, sizeof(value));
+}
+
+void eeprom_update_dword(uint32_t* address, uint32_t value)
+{
+    eeprom_update_block(&value, address, sizeof(value));
+}
+
+void eeprom_update_block(const void* source, void* destination, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        _eepromWrite((uint8_t*)destination + i, ((const uint8_t*)source)[i], 1);
+    }
+}
@@ -0,0 +1,108 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file HostSim.h
+ * A functional model of the parts of the ATtiny84 IR Thing uses so the
+ * firmware can run on a development machine. Time only advances while the
+ * firmware sleeps or delays (plus a token amount for each sei/cli window),
+ * code runs in zero time. As on the part, the instruction after sei always
+ * runs before a pending interrupt so sei(); sleep_cpu(); can't miss a
+ * wakeup. Modeled are GPIO, Timer0, Timer1 (including input capture), INT0,
+ * PCINT0/1, the watchdog, the system clock prescaler, sleep modes and EEPROM.
+ *
+ * The firmware runs on its own stack. The host drives it by scheduling input
+ * changes and calling HostSimRunUntil, which returns once simulated time
+ * reaches the requested point.
+ */
+
+#ifndef HOSTSIM_H_
+#define HOSTSIM_H_
+
+#include <stdint.h>
+
+#define HOSTSIM_PORTA 0
+#define HOSTSIM_PORTB 1
+
+/**
+ * Simulated time in system clock cycles (before the clock prescaler).
+ */
+typedef uint64_t HostSimCycles;
+
+/**
+ * Called whenever the level driven onto a port changes. Bit PA5 reflects the
+ * OC1B waveform generator: set while it is connected and Timer1 runs.
+ */
+typedef void (*HostSimOutputFunc)(HostSimCycles at, uint8_t port, uint8_t driven);
+
+typedef void (*HostSimEntryFunc)(void);
+
+/**
+ * Running totals for benchmarking.
+ */
+typedef struct _HostSimStatsType
+{
+    uint32_t interrupts;
+    uint32_t inputEdges;
+    uint32_t wakeups;
+    uint32_t eepromWrites;
+} HostSimStats;
+
+/**
+ * Power on the simulated MCU. Registers are reset, EEPROM contents are kept
+ * (all 0xFF the first time).
+ * \param  entry    The firmware's main function.
+ * \param  cpuHz    The system clock frequency.
+ */
+void HostSimStart(HostSimEntryFunc entry, uint32_t cpuHz);
+
+/**
+ * Run the firmware until simulated time reaches at.
+ * \return 0 if the firmware's main function returned or the watchdog reset
+ *         the device, 1 otherwise.
+ */
+uint8_t HostSimRunUntil(HostSimCycles at);
+
+HostSimCycles HostSimNow(void);
+HostSimCycles HostSimMillisToCycles(uint32_t millis);
+HostSimCycles HostSimMicrosToCycles(uint32_t micros);
+
+/**
+ * Change an external input at a point in the future. Inputs must be
+ * scheduled in order. All inputs idle high.
+ */
+void HostSimScheduleInput(HostSimCycles at, uint8_t port, uint8_t pin, uint8_t level);
+
+void HostSimSetOutputObserver(HostSimOutputFunc observer);
+
+/**
+ * \return 1 if the simulated MCU is sleeping, in any sleep mode.
+ */
+uint8_t HostSimIsSleeping(void);
+
+const HostSimStats* HostSimGetStats(void);
+
+// +--------------------------------------------------------------------------+
+// | FIRMWARE SIDE. Used by the avr/ and util/ stand-ins.
+// +--------------------------------------------------------------------------+
+uint8_t HostSimReadPins(uint8_t port);
+void HostSimClearFlags(volatile uint8_t* reg, uint8_t flags);
+void HostSimEnableInterrupts(void);
+void HostSimDisableInterrupts(void);
+void HostSimSleep(void);
+void HostSimDelayCycles(uint32_t cpuCycles);
+void HostSimWatchdogReset(void);
+void HostSimSetClockDivision(uint8_t division);
+uint8_t HostSimGetClockDivision(void);
+uint8_t* HostSimEepromAddress(const void* address);
+
+/**
+ * Tinker's critical sections (TINKER_CRITICAL_EXTERN): save SREG and cli, then
+ * restore the saved interrupt flag.
+ */
+uint8_t TinkerEnterCritical(void);
+void TinkerExitCritical(uint8_t state);
+
+#endif /* HOSTSIM_H_ */
@@ -0,0 +1,33 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_AVR_EEPROM_H_
+#define HOSTSIM_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "HostSim.h"
+
+// EEMEM variables are only used for their addresses. HostSim maps them onto
+// its EEPROM image.
+#define EEMEM __attribute__((section("hostsim_eeprom")))
+
+uint8_t eeprom_read_byte(const uint8_t* address);
+uint16_t eeprom_read_word(const uint16_t* address);
+uint32_t eeprom_read_dword(const uint32_t* address);
+void eeprom_read_block(void* destination, const void* source, size_t length);
+void eeprom_write_byte(uint8_t* address, uint8_t value);
+void eeprom_write_word(uint16_t* address, uint16_t value);
+void eeprom_write_block(const void* source, void* destination, size_t length);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+void eeprom_update_word(uint16_t* address, uint16_t value);
+void eeprom_update_dword(uint32_t* address, uint32_t value);
+void eeprom_update_block(const void* source, void* destination, size_t length);
+
+#define eeprom_is_ready() 1
+#define eeprom_busy_wait()
+
+#endif /* HOSTSIM_AVR_EEPROM_H_ */
@@ -0,0 +1,31 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_AVR_INTERRUPT_H_
+#define HOSTSIM_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void); void vector(void) {}
+
+#define sei() HostSimEnableInterrupts()
+#define cli() HostSimDisableInterrupts()
+
+// Vectors are plain functions. HostSim supplies empty weak defaults.
+void INT0_vect(void);
+void PCINT0_vect(void);
+void PCINT1_vect(void);
+void WDT_vect(void);
+void TIM1_CAPT_vect(void);
+void TIM1_COMPA_vect(void);
+void TIM1_COMPB_vect(void);
+void TIM1_OVF_vect(void);
+void TIM0_COMPA_vect(void);
+void TIM0_COMPB_vect(void);
+void TIM0_OVF_vect(void);
+
+#endif /* HOSTSIM_AVR_INTERRUPT_H_ */
@@ -0,0 +1,262 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file avr/io.h
+ * Host stand-in for the ATtiny84 register file. Registers are plain variables
+ * owned by HostSim. Input registers and write-1-to-clear flags go through
+ * HostSim functions since plain variables can't behave like them.
+ */
+
+#ifndef HOSTSIM_AVR_IO_H_
+#define HOSTSIM_AVR_IO_H_
+
+#include <stdint.h>
+#include "HostSim.h"
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+
+#define E2END 511
+#define RAMEND 0x25F
+
+// +--------------------------------------------------------------------------+
+// | REGISTERS
+// +--------------------------------------------------------------------------+
+
+extern volatile uint8_t PORTA;
+extern volatile uint8_t DDRA;
+extern volatile uint8_t PORTB;
+extern volatile uint8_t DDRB;
+extern volatile uint8_t TCCR0A;
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t TIFR0;
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t OCR0B;
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TCCR1C;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+extern volatile uint8_t GIMSK;
+extern volatile uint8_t GIFR;
+extern volatile uint8_t PCMSK0;
+extern volatile uint8_t PCMSK1;
+extern volatile uint8_t MCUCR;
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t PRR;
+extern volatile uint8_t ACSR;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t DIDR0;
+extern volatile uint8_t SREG;
+extern volatile uint8_t WDTCSR;
+extern volatile uint8_t CLKPR;
+extern volatile uint8_t OSCCAL;
+extern volatile uint8_t GPIOR0;
+extern volatile uint8_t GPIOR1;
+extern volatile uint8_t GPIOR2;
+extern volatile uint8_t EECR;
+extern volatile uint8_t EEARL;
+extern volatile uint8_t EEDR;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint16_t ICR1;
+
+#define PINA HostSimReadPins(HOSTSIM_PORTA)
+#define PINB HostSimReadPins(HOSTSIM_PORTB)
+
+#define CLEAR_INTERRUPT_FLAGS(REG, FLAGS) HostSimClearFlags(&(REG), (FLAGS))
+
+// +--------------------------------------------------------------------------+
+// | BITS
+// +--------------------------------------------------------------------------+
+#define PINA0 0
+#define PINA1 1
+#define PINA2 2
+#define PINA3 3
+#define PINA4 4
+#define PINA5 5
+#define PINA6 6
+#define PINA7 7
+
+#define PINB0 0
+#define PINB1 1
+#define PINB2 2
+#define PINB3 3
+
+#define PORTA0 0
+#define PORTA1 1
+#define PORTA2 2
+#define PORTA3 3
+#define PORTA4 4
+#define PORTA5 5
+#define PORTA6 6
+#define PORTA7 7
+
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+
+#define DDA0 0
+#define DDA1 1
+#define DDA2 2
+#define DDA3 3
+#define DDA4 4
+#define DDA5 5
+#define DDA6 6
+#define DDA7 7
+
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01 1
+#define WGM00 0
+
+#define FOC0A 7
+#define FOC0B 6
+#define WGM02 3
+#define CS02 2
+#define CS01 1
+#define CS00 0
+
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+
+#define OCF0B 2
+#define OCF0A 1
+#define TOV0 0
+
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11 1
+#define WGM10 0
+
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+
+#define FOC1A 7
+#define FOC1B 6
+
+#define ICIE1 5
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+
+#define ICF1 5
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+
+#define INT0 6
+#define PCIE1 5
+#define PCIE0 4
+
+#define INTF0 6
+#define PCIF1 5
+#define PCIF0 4
+
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCINT6 6
+#define PCINT7 7
+
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+
+#define BODS 7
+#define PUD 6
+#define SE 5
+#define SM1 4
+#define SM0 3
+#define BODSE 2
+#define ISC01 1
+#define ISC00 0
+
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+
+#define PRTIM1 3
+#define PRTIM0 2
+#define PRUSI 1
+#define PRADC 0
+
+#define ACD 7
+#define ACBG 6
+#define ACO 5
+#define ACI 4
+#define ACIE 3
+#define ACIC 2
+#define ACIS1 1
+#define ACIS0 0
+
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+#define WDIF 7
+#define WDIE 6
+#define WDP3 5
+#define WDCE 4
+#define WDE 3
+#define WDP2 2
+#define WDP1 1
+#define WDP0 0
+
+#define CLKPCE 7
+#define CLKPS3 3
+#define CLKPS2 2
+#define CLKPS1 1
+#define CLKPS0 0
+
+#define SREG_I 7
+
+#endif /* HOSTSIM_AVR_IO_H_ */
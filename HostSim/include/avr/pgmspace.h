@@ -0,0 +1,22 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_AVR_PGMSPACE_H_
+#define HOSTSIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// There is only one address space on the host.
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define pgm_read_dword(address) (*(const uint32_t*)(address))
+#define pgm_read_ptr(address) (*(void* const*)(address))
+#define memcpy_P(destination, source, length) memcpy((destination), (source), (length))
+
+#endif /* HOSTSIM_AVR_PGMSPACE_H_ */
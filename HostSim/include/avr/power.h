@@ -0,0 +1,39 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_AVR_POWER_H_
+#define HOSTSIM_AVR_POWER_H_
+
+#include <avr/io.h>
+
+#define power_adc_enable() (PRR &= ~_BV(PRADC))
+#define power_adc_disable() (PRR |= _BV(PRADC))
+#define power_usi_enable() (PRR &= ~_BV(PRUSI))
+#define power_usi_disable() (PRR |= _BV(PRUSI))
+#define power_timer0_enable() (PRR &= ~_BV(PRTIM0))
+#define power_timer0_disable() (PRR |= _BV(PRTIM0))
+#define power_timer1_enable() (PRR &= ~_BV(PRTIM1))
+#define power_timer1_disable() (PRR |= _BV(PRTIM1))
+#define power_all_enable() (PRR &= ~(_BV(PRADC) | _BV(PRUSI) | _BV(PRTIM0) | _BV(PRTIM1)))
+#define power_all_disable() (PRR |= (_BV(PRADC) | _BV(PRUSI) | _BV(PRTIM0) | _BV(PRTIM1)))
+
+typedef enum
+{
+    clock_div_1 = 0,
+    clock_div_2 = 1,
+    clock_div_4 = 2,
+    clock_div_8 = 3,
+    clock_div_16 = 4,
+    clock_div_32 = 5,
+    clock_div_64 = 6,
+    clock_div_128 = 7,
+    clock_div_256 = 8
+} clock_div_t;
+
+#define clock_prescale_set(division) HostSimSetClockDivision(division)
+#define clock_prescale_get() ((clock_div_t)HostSimGetClockDivision())
+
+#endif /* HOSTSIM_AVR_POWER_H_ */
@@ -0,0 +1,24 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_AVR_SLEEP_H_
+#define HOSTSIM_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE      0
+#define SLEEP_MODE_ADC       _BV(SM0)
+#define SLEEP_MODE_PWR_DOWN  _BV(SM1)
+#define SLEEP_MODE_STANDBY   (_BV(SM1) | _BV(SM0))
+
+#define set_sleep_mode(mode) (MCUCR = (MCUCR & ~(_BV(SM1) | _BV(SM0))) | (mode))
+#define sleep_enable() (MCUCR |= _BV(SE))
+#define sleep_disable() (MCUCR &= ~_BV(SE))
+#define sleep_cpu() HostSimSleep()
+#define sleep_bod_disable()
+#define sleep_mode() do { sleep_enable(); sleep_cpu(); sleep_disable(); } while(0)
+
+#endif /* HOSTSIM_AVR_SLEEP_H_ */
@@ -0,0 +1,50 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_UTIL_ATOMIC_H_
+#define HOSTSIM_UTIL_ATOMIC_H_
+
+#include <avr/interrupt.h>
+
+static __inline__ uint8_t __iCliRetVal(void)
+{
+    cli();
+    return 1;
+}
+
+static __inline__ void __iSeiParam(const uint8_t* __s)
+{
+    (void)__s;
+    sei();
+}
+
+static __inline__ void __iCliParam(const uint8_t* __s)
+{
+    (void)__s;
+    cli();
+}
+
+static __inline__ void __iRestore(const uint8_t* __s)
+{
+    if (*__s & _BV(SREG_I))
+    {
+        sei();
+    }
+    else
+    {
+        cli();
+    }
+}
+
+#define ATOMIC_BLOCK(type) for (type, __ToDo = __iCliRetVal(); __ToDo; __ToDo = 0)
+#define NONATOMIC_BLOCK(type) for (type, __ToDo = (sei(), 1); __ToDo; __ToDo = 0)
+
+#define ATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define ATOMIC_FORCEON uint8_t sreg_save __attribute__((__cleanup__(__iSeiParam))) = 0
+#define NONATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define NONATOMIC_FORCEOFF uint8_t sreg_save __attribute__((__cleanup__(__iCliParam))) = 0
+
+#endif /* HOSTSIM_UTIL_ATOMIC_H_ */
@@ -0,0 +1,25 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_UTIL_CRC16_H_
+#define HOSTSIM_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+/**
+ * Same polynomial (0x07) and bit order as avr-libc's.
+ */
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+#endif /* HOSTSIM_UTIL_CRC16_H_ */
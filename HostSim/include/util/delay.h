@@ -0,0 +1,19 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_UTIL_DELAY_H_
+#define HOSTSIM_UTIL_DELAY_H_
+
+#include "HostSim.h"
+
+#ifndef F_CPU
+#error F_CPU must be defined before including util/delay.h
+#endif
+
+#define _delay_ms(ms) HostSimDelayCycles((uint32_t)((double)(ms) * ((double)F_CPU / 1000.0)))
+#define _delay_us(us) HostSimDelayCycles((uint32_t)((double)(us) * ((double)F_CPU / 1000000.0)))
+
+#endif /* HOSTSIM_UTIL_DELAY_H_ */
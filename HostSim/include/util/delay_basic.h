@@ -0,0 +1,15 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#ifndef HOSTSIM_UTIL_DELAY_BASIC_H_
+#define HOSTSIM_UTIL_DELAY_BASIC_H_
+
+#include "HostSim.h"
+
+#define _delay_loop_1(count) HostSimDelayCycles(3UL * ((count) ? (count) : 256))
+#define _delay_loop_2(count) HostSimDelayCycles(4UL * ((count) ? (count) : 65536))
+
+#endif /* HOSTSIM_UTIL_DELAY_BASIC_H_ */
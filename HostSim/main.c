@@ -0,0 +1,243 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Runs the IR Thing firmware on the host simulator through a typical session
+ * and reports what it did along with how fast the simulation ran:
+ *
+ *   power on -> click (visualize) -> IR traffic -> click (capture) -> one NEC
+ *   frame -> click (transmit) -> long press (power down)
+ *
+ * The run fails unless the captured code was decoded and saved to EEPROM, the
+ * replay decodes back to it with a header of the right length and the
+ * firmware ends up asleep.
+ *
+ * Usage: irthing_sim [visualize frame count]
+ */
+
+#include "HostSim.h"
+#include "IRProtocol.h"
+#include "PatternStore.h"
+#include <avr/io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define _CPU_HZ 20000000UL
+#define _NEC_ADDRESS 0x04
+#define _NEC_COMMAND 0x08
+#define _DEFAULT_VISUALIZE_FRAMES 20000
+#define _NEC_HEADER_MARK_MICROS 9000
+#define _MAX_CARRIER_EDGES 128
+
+int IRThingMain(void);
+
+static struct
+{
+    uint32_t carrierBursts;
+    uint32_t visualEdges;
+    uint8_t lastDriven;
+    /**
+     * When PA5 (the carrier) changed, rising edge first. Only the one
+     * replay is expected.
+     */
+    HostSimCycles carrierEdges[_MAX_CARRIER_EDGES];
+    uint8_t carrierEdgeCount;
+} _observed;
+
+static uint8_t _failures;
+
+static void _runFirmware(void)
+{
+    IRThingMain();
+}
+
+static void _onOutput(HostSimCycles at, uint8_t port, uint8_t driven)
+{
+    if (HOSTSIM_PORTA != port)
+    {
+        return;
+    }
+    const uint8_t changed = driven ^ _observed.lastDriven;
+    if ((changed & _BV(PA5)) && (driven & _BV(PA5)))
+    {
+        ++_observed.carrierBursts;
+    }
+    if ((changed & _BV(PA5)) && _observed.carrierEdgeCount < _MAX_CARRIER_EDGES &&
+        (_observed.carrierEdgeCount || (driven & _BV(PA5))))
+    {
+        _observed.carrierEdges[_observed.carrierEdgeCount++] = at;
+    }
+    if (changed & _BV(PA1))
+    {
+        ++_observed.visualEdges;
+    }
+    _observed.lastDriven = driven;
+}
+
+/**
+ * \return The time after the IR receiver goes idle again.
+ */
+static HostSimCycles _scheduleMark(HostSimCycles at, uint32_t markMicros, uint32_t spaceMicros)
+{
+    // The receiver output is active low.
+    HostSimScheduleInput(at, HOSTSIM_PORTA, PA7, 0);
+    at += HostSimMicrosToCycles(markMicros);
+    HostSimScheduleInput(at, HOSTSIM_PORTA, PA7, 1);
+    return at + HostSimMicrosToCycles(spaceMicros);
+}
+
+static HostSimCycles _scheduleNecFrame(HostSimCycles at, uint8_t address, uint8_t command)
+{
+    const uint32_t data = (uint32_t)address | ((uint32_t)(uint8_t)~address << 8) |
+                          ((uint32_t)command << 16) | ((uint32_t)(uint8_t)~command << 24);
+    at = _scheduleMark(at, 9000, 4500);
+    for (uint8_t bit = 0; bit < 32; ++bit)
+    {
+        at = _scheduleMark(at, 560, (data & (1UL << bit)) ? 1690 : 560);
+    }
+    return _scheduleMark(at, 560, 40000);
+}
+
+static HostSimCycles _scheduleClick(HostSimCycles at, uint32_t heldMillis)
+{
+    HostSimScheduleInput(at, HOSTSIM_PORTB, PB2, 0);
+    at += HostSimMillisToCycles(heldMillis);
+    HostSimScheduleInput(at, HOSTSIM_PORTB, PB2, 1);
+    // Clicks are only dispatched once no second click can follow.
+    return at + HostSimMillisToCycles(500);
+}
+
+static void _check(uint8_t isTrue, const char* what)
+{
+    if (!isTrue)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        ++_failures;
+    }
+}
+
+static uint32_t _cyclesToMicros(HostSimCycles cycles)
+{
+    return (uint32_t)(cycles / (_CPU_HZ / 1000000UL));
+}
+
+static uint8_t _isExpectedCode(const IRCode* code)
+{
+    return (IRPROTOCOL_NEC == code->protocol && _NEC_ADDRESS == code->address && _NEC_COMMAND == code->command);
+}
+
+/**
+ * Decode the recorded carrier the way a receiver would.
+ */
+static uint8_t _decodeReplay(IRCode* code)
+{
+    IRDecoder decoder;
+    IRDecoderInit(&decoder);
+    for (uint8_t i = 0; i + 1 < _observed.carrierEdgeCount; ++i)
+    {
+        const uint32_t micros = _cyclesToMicros(_observed.carrierEdges[i + 1] - _observed.carrierEdges[i]);
+        FeedIRDecoder(&decoder, !(i & 1), (micros > 0xFFFF) ? 0xFFFF : micros);
+    }
+    return FinishIRDecoder(&decoder, code);
+}
+
+/**
+ * \return 1 if the firmware saved the expected code. Reads the simulated
+ *         EEPROM through the firmware's own journal.
+ */
+static uint8_t _isExpectedCodeStored(void)
+{
+    PatternStore store;
+    IRCode code;
+    PatternStoreInit(&store);
+    return (LoadPattern(&store, 0, &code) && _isExpectedCode(&code));
+}
+
+static uint8_t _runUntil(HostSimCycles at)
+{
+    if (!HostSimRunUntil(at))
+    {
+        fprintf(stderr, "firmware stopped at %llu cycles\n", (unsigned long long)HostSimNow());
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t visualizeFrames = (argc > 1) ? strtoul(argv[1], 0, 0) : _DEFAULT_VISUALIZE_FRAMES;
+    HostSimSetOutputObserver(_onOutput);
+    HostSimStart(_runFirmware, _CPU_HZ);
+
+    HostSimCycles at = HostSimMillisToCycles(1000);
+    if (!_runUntil(at))
+    {
+        return 1;
+    }
+
+    // Visualize a burst of IR traffic.
+    at = _scheduleClick(at, 50);
+    if (!_runUntil(at))
+    {
+        return 1;
+    }
+    const uint32_t edgesBefore = HostSimGetStats()->inputEdges;
+    const uint32_t interruptsBefore = HostSimGetStats()->interrupts;
+    const HostSimCycles visualizeStart = at;
+    const clock_t wallStart = clock();
+    for (uint32_t frame = 0; frame < visualizeFrames; ++frame)
+    {
+        at = _scheduleNecFrame(at, _NEC_ADDRESS, _NEC_COMMAND);
+        if (!_runUntil(at))
+        {
+            return 1;
+        }
+    }
+    const double wallSeconds = (double)(clock() - wallStart) / CLOCKS_PER_SEC;
+    const uint32_t edges = HostSimGetStats()->inputEdges - edgesBefore;
+    const uint32_t interrupts = HostSimGetStats()->interrupts - interruptsBefore;
+    const double simulatedSeconds = (double)(at - visualizeStart) / _CPU_HZ;
+
+    // Capture one frame then click to transmit it.
+    at = _scheduleClick(at, 50);
+    at = _scheduleNecFrame(at, _NEC_ADDRESS, _NEC_COMMAND);
+    at = _scheduleClick(at + HostSimMillisToCycles(1500), 50);
+    at += HostSimMillisToCycles(1000);
+    if (!_runUntil(at))
+    {
+        return 1;
+    }
+    const uint32_t bursts = _observed.carrierBursts;
+    IRCode replayed;
+    _check(_isExpectedCodeStored(), "captured code saved to EEPROM");
+    _check(_decodeReplay(&replayed) && _isExpectedCode(&replayed), "replay decodes to the captured code");
+    if (_observed.carrierEdgeCount >= 2)
+    {
+        const uint32_t headerMicros = _cyclesToMicros(_observed.carrierEdges[1] - _observed.carrierEdges[0]);
+        _check(headerMicros + IRPROTOCOL_TOLERANCE_MICROS >= _NEC_HEADER_MARK_MICROS &&
+               headerMicros <= _NEC_HEADER_MARK_MICROS + IRPROTOCOL_TOLERANCE_MICROS, "replayed header mark length");
+    }
+
+    // Long press to power down.
+    at = _scheduleClick(at, 2000);
+    at += HostSimMillisToCycles(2000);
+    if (!_runUntil(at))
+    {
+        return 1;
+    }
+
+    const HostSimStats* stats = HostSimGetStats();
+    printf("visualize: %u frames, %u input edges, %u interrupts, %u LED edges\n",
+           visualizeFrames, edges, interrupts, _observed.visualEdges);
+    printf("           %.1f simulated s in %.3f s (%.0fx real time, %.0f edges/s)\n",
+           simulatedSeconds, wallSeconds,
+           wallSeconds > 0 ? simulatedSeconds / wallSeconds : 0.0,
+           wallSeconds > 0 ? edges / wallSeconds : 0.0);
+    printf("repeat:    %u carrier bursts, %u EEPROM bytes written\n", bursts, stats->eepromWrites);
+    printf("shutdown:  %s after %u wakeups\n", HostSimIsSleeping() ? "asleep" : "AWAKE", stats->wakeups);
+    _check(HostSimIsSleeping(), "asleep after the long press");
+    return (_failures) ? 1 : 0;
+}
@@ -40,6 +40,14 @@
 #define ENABLE_EXTERNAL_INTERRUPT(EXTINTNUM) GIMSK |= (1<<INT##EXTINTNUM);
 #define DISABLE_EXTERNAL_INTERRUPT(EXTINTNUM) GIMSK &= ~(1<<INT##EXTINTNUM);
 
+/**
+ * Interrupt flags are cleared by writing a 1 to them. The host simulator
+ * supplies its own version since a plain variable can't behave that way.
+ */
+#ifndef CLEAR_INTERRUPT_FLAGS
+#define CLEAR_INTERRUPT_FLAGS(REG, FLAGS) (REG) = (FLAGS)
+#endif
+
 // +--------------------------------------------------------------------------+
 // | PINS
 // +--------------------------------------------------------------------------+
@@ -49,21 +57,117 @@
 #define PINB_RUNBUTT  PINB2
 #define PINA_IR_OUT   PINA2
 #define PINA_PERIPH   PINA3
+#define PINA_IR_CARRIER PINA5 /**< OC1B. Modulated output for the IR LED. */
 
 // +--------------------------------------------------------------------------+
 // | RUN LOOPS
 // +--------------------------------------------------------------------------+
 #include "tinker/RunLoop.h"
 
-/**
- *
- */
-extern RunLoop mainRunLoop;
-
-#define RUNLOOP_MESSAGE_FRAME 0
+#include "tinker/Timer.h"
+
+/**
+ * Drained by main(). ISRs post their work here.
+ */
+extern RunLoop mainRunLoop;
+
+/**
+ * Timers for mainRunLoop. Backed by Timer0 which only runs while a timer is
+ * scheduled.
+ */
+extern TimerService mainTimerService;
+
+// +--------------------------------------------------------------------------+
+// | INDICATORS
+// +--------------------------------------------------------------------------+
+/**
+ * Non-zero while an indicator animation owns PINA_VISUAL. Code that mirrors
+ * IR activity onto the pin leaves it alone until the animation stops.
+ */
+extern volatile uint8_t visualPinIsHeld;
+
+static inline void mirrorOntoVisualPin(uint8_t isLit)
+{
+    if (visualPinIsHeld)
+    {
+        return;
+    }
+    if (isLit)
+    {
+        PORTA |= _BV(PINA_VISUAL);
+    }
+    else
+    {
+        PORTA &= ~_BV(PINA_VISUAL);
+    }
+}
+
+// +--------------------------------------------------------------------------+
+// | CLOCK
+// +--------------------------------------------------------------------------+
+/**
+ * System clock divisions (clock_div_t values). Timer0 is moved to a matching
+ * prescaler whenever the division changes so it keeps counting at
+ * F_CPU / 1024 and mainTimerService never notices. Only clock_div_1, _4, _16
+ * and _128 have a match.
+ */
+#define CLOCK_DIVISION_FULL clock_div_1     /**< 20MHz. Capture and playback. */
+#define CLOCK_DIVISION_SLOW clock_div_16    /**< 1.25MHz. Everything else. */
+
+/**
+ * Change the system clock. Does nothing if the division has no matching
+ * Timer0 prescaler. IRCapture, IRPlayback and _delay_ms/_delay_us assume
+ * F_CPU so the drivers switch to CLOCK_DIVISION_FULL when they start and the
+ * delays are only used before the clock is first slowed.
+ * \param  division   A CLOCK_DIVISION_XXXX (clock_div_t) value.
+ */
+void setSystemClock(uint8_t division);
+
+/**
+ * \return The current system clock frequency.
+ */
+uint32_t getSystemClockHz();
+
+// +--------------------------------------------------------------------------+
+// | POWER
+// +--------------------------------------------------------------------------+
+/**
+ * Sleep levels for the TINKER_POWER of a state, lightest first.
+ */
+#define POWER_SLEEP_NONE        0   /**< Busy. Don't sleep at all. */
+#define POWER_SLEEP_IDLE        1   /**< CPU stops. Timers and their interrupts keep running. */
+#define POWER_SLEEP_POWER_DOWN  2   /**< Only INT0, pin changes and the watchdog wake us. */
+
+/**
+ * Peripherals for the TINKER_POWER of a state. These are PRR bits. Timer0
+ * keeps time for mainTimerService and is never gated.
+ */
+#define POWER_PERIPHERAL_TIMER1 _BV(PRTIM1)
+#define POWER_PERIPHERAL_USI    _BV(PRUSI)
+#define POWER_PERIPHERAL_ADC    _BV(PRADC)
+#define POWER_PERIPHERALS_ALL   (POWER_PERIPHERAL_TIMER1 | POWER_PERIPHERAL_USI | POWER_PERIPHERAL_ADC)
+
+/**
+ * Not a PRR bit. Keeps the system clock at CLOCK_DIVISION_FULL even while
+ * Timer1 is gated, for states whose interrupts have to respond quickly.
+ * This is the most expensive way to wait: such a state can sleep no deeper
+ * than idle, which at the full clock draws milliamps where power down
+ * draws microamps. Only use it where the latency of waking from power down
+ * (the crystal restart) or of running on the slow clock would be visible.
+ */
+#define POWER_PERIPHERAL_FULL_CLOCK _BV(7)
 
-extern void disableMainLoopTimer();
-extern void enableMainLoopTimer();
-extern void driveMainRunLoop(uint8_t timeSinceLastRunMillis);
+/**
+ * The power governor. Sleeps until the next interrupt as deeply as the
+ * entered states allow, unless mainRunLoop already has work. The clock is
+ * slowed first unless Timer1 (capture or playback) is running or an entered
+ * state needs POWER_PERIPHERAL_FULL_CLOCK. The governor honors that flag
+ * as given and never trades it for a deeper sleep; VisualizeState and
+ * RepeatingState use it so they stay in full clock idle until the device
+ * is switched off. Must be called
+ * with interrupts disabled (as state loops are) so a wakeup can't be missed
+ * between deciding to sleep and sleeping. Returns with interrupts enabled.
+ */
+void sleepUntilInterrupt();
 
 #endif /* FRAMEWORK_H_ */
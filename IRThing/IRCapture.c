@@ -0,0 +1,136 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "IRCapture.h"
+
+#define _QUEUE_MASK (IRCAPTURE_QUEUE_SIZE - 1)
+
+static IREdge _queue[IRCAPTURE_QUEUE_SIZE];
+static volatile uint8_t _head;
+static volatile uint8_t _tail;
+static volatile uint8_t _wraps;
+static volatile uint8_t _overrun;
+static uint16_t _lastStamp;
+
+void StartIRCapture()
+{
+    // Tick conversions assume F_CPU.
+    setSystemClock(CLOCK_DIVISION_FULL);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        power_timer1_enable();
+        _head = 0;
+        _tail = 0;
+        _wraps = 0;
+        _overrun = 0;
+        _lastStamp = 0;
+        TCCR1A = 0;
+        TCNT1 = 0;
+        // Normal mode, clk/8, noise canceler on. The receiver idles high so the
+        // first edge we care about is the falling edge at the start of a mark.
+        TCCR1B = _BV(ICNC1) | _BV(CS11);
+        CLEAR_INTERRUPT_FLAGS(TIFR1, _BV(ICF1) | _BV(TOV1));
+        TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+    }
+}
+
+void StopIRCapture()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TIMSK1 = 0;
+        TCCR1B = 0;
+        CLEAR_INTERRUPT_FLAGS(TIFR1, _BV(ICF1) | _BV(TOV1));
+        power_timer1_disable();
+    }
+}
+
+uint8_t ReadIRCaptureEdge(IREdge* edge)
+{
+    uint8_t result = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        const uint8_t tail = _tail;
+        if (tail != _head)
+        {
+            *edge = _queue[tail];
+            _tail = (tail + 1) & _QUEUE_MASK;
+            result = 1;
+        }
+    }
+    return result;
+}
+
+uint8_t HasIRCaptureEdges()
+{
+    return (_tail != _head);
+}
+
+uint8_t HasIRCaptureOverrun()
+{
+    return _overrun;
+}
+
+uint8_t GetIRCaptureSilence()
+{
+    return _wraps;
+}
+
+ISR(TIM1_CAPT_vect)
+{
+    const uint16_t stamp = ICR1;
+    uint8_t wraps = _wraps;
+
+    // An overflow that happened just before this capture may not have been
+    // serviced yet. Account for it here so it isn't counted against the
+    // next interval.
+    if ((TIFR1 & _BV(TOV1)) && stamp < 0x8000)
+    {
+        CLEAR_INTERRUPT_FLAGS(TIFR1, _BV(TOV1));
+        if (wraps < 0xFF)
+        {
+            ++wraps;
+        }
+    }
+
+    // The interval that just ended was a mark if we were waiting for the
+    // receiver to go high again.
+    const uint8_t control = TCCR1B;
+    const uint8_t flags = (control & _BV(ICES1)) ? IREDGE_FLAG_MARK : 0;
+    TCCR1B = control ^ _BV(ICES1);
+    // Changing the edge select can raise a spurious capture flag.
+    CLEAR_INTERRUPT_FLAGS(TIFR1, _BV(ICF1));
+
+    if (stamp < _lastStamp && wraps)
+    {
+        // The subtraction below borrows one of the wraps.
+        --wraps;
+    }
+
+    const uint8_t head = _head;
+    const uint8_t next = (head + 1) & _QUEUE_MASK;
+    if (next != _tail)
+    {
+        _queue[head].ticks = stamp - _lastStamp;
+        _queue[head].flags = flags | ((wraps > IREDGE_WRAPS_MASK) ? IREDGE_WRAPS_MASK : wraps);
+        _head = next;
+    }
+    else
+    {
+        _overrun = 1;
+    }
+
+    _lastStamp = stamp;
+    _wraps = 0;
+}
+
+ISR(TIM1_OVF_vect)
+{
+    if (_wraps < 0xFF)
+    {
+        ++_wraps;
+    }
+}
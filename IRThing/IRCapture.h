@@ -0,0 +1,104 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file IRCapture.h
+ * Edge timestamping for the IR receiver using the Timer1 input capture unit.
+ * PINA_IR_IN (PA7) is ICP1 so the hardware latches the timer on every edge
+ * and the capture ISR only has to queue the interval since the previous edge.
+ * The foreground drains the queue at its leisure (or sleeps while it's empty)
+ * without affecting the accuracy of the measured durations.
+ */
+
+#ifndef IRCAPTURE_H_
+#define IRCAPTURE_H_
+
+#include "Framework.h"
+
+/**
+ * Number of edges the capture ISR can queue before the foreground must drain
+ * them. Must be a power of 2.
+ */
+#ifndef IRCAPTURE_QUEUE_SIZE
+#define IRCAPTURE_QUEUE_SIZE 8
+#endif
+
+/**
+ * Timer1 clock divider used while capturing. At 20MHz this is 0.4us per tick
+ * and ~26ms per counter wrap.
+ */
+#define IRCAPTURE_PRESCALE 8
+
+#define IRCAPTURE_TICKS_TO_MICROS(TICKS) (((uint32_t)(TICKS) * IRCAPTURE_PRESCALE) / (F_CPU / 1000000UL))
+#define IRCAPTURE_MICROS_TO_TICKS(MICROS) (((uint32_t)(MICROS) * (F_CPU / 1000000UL)) / IRCAPTURE_PRESCALE)
+#define IRCAPTURE_MILLIS_TO_WRAPS(MILLIS) (((uint32_t)(MILLIS) * (F_CPU / 1000UL) / IRCAPTURE_PRESCALE) >> 16)
+
+/**
+ * Set in IREdge::flags if the interval that ended with this edge was a mark
+ * (IR receiver output pulled low).
+ */
+#define IREDGE_FLAG_MARK 0x80
+#define IREDGE_WRAPS_MASK 0x7F
+
+/**
+ * \struct IREdge
+ * The interval between two consecutive edges on the IR receiver pin.
+ */
+typedef struct _IREdgeType
+{
+    /**
+     * Low 16 bits of the interval in Timer1 ticks.
+     */
+    uint16_t ticks;
+
+    /**
+     * IREDGE_FLAG_MARK and the number of whole Timer1 wraps in the interval
+     * (saturates at IREDGE_WRAPS_MASK).
+     */
+    uint8_t flags;
+} IREdge;
+
+/**
+ * Power up Timer1 and start timestamping edges on PINA_IR_IN.
+ */
+void StartIRCapture();
+
+/**
+ * Stop timestamping edges and power down Timer1.
+ */
+void StopIRCapture();
+
+/**
+ * Dequeue the oldest captured edge.
+ * \param  edge   Populated with the edge if one was available.
+ * \return 1 if an edge was dequeued, 0 if the queue was empty.
+ */
+uint8_t ReadIRCaptureEdge(IREdge* edge);
+
+/**
+ * \return 1 if there are edges waiting to be read.
+ */
+uint8_t HasIRCaptureEdges();
+
+/**
+ * \return 1 if the ISR had to drop an edge because the queue was full since
+ *         capture was started.
+ */
+uint8_t HasIRCaptureOverrun();
+
+/**
+ * \return The number of Timer1 wraps since the last edge (saturates at 0xFF).
+ */
+uint8_t GetIRCaptureSilence();
+
+/**
+ * \return The full duration of an edge interval in Timer1 ticks.
+ */
+static inline uint32_t GetIREdgeTicks(const IREdge* edge)
+{
+    return ((uint32_t)(edge->flags & IREDGE_WRAPS_MASK) << 16) | edge->ticks;
+}
+
+#endif /* IRCAPTURE_H_ */
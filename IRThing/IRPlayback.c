@@ -0,0 +1,162 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "IRPlayback.h"
+
+#define _QUEUE_MASK (IRPLAYBACK_QUEUE_SIZE - 1)
+
+#define _SEGMENT_IDLE  0
+#define _SEGMENT_MARK  1
+#define _SEGMENT_SPACE 2
+
+#define _GATE_ON()  do { TCCR1A |= _BV(COM1B1); PORTA |= _BV(PINA_IR_OUT) | _BV(PINA_VISUAL); } while(0)
+#define _GATE_OFF() do { TCCR1A &= ~_BV(COM1B1); PORTA &= ~(_BV(PINA_IR_OUT) | _BV(PINA_VISUAL)); } while(0)
+
+/**
+ * A mark and the space that follows it in carrier cycles.
+ */
+typedef struct _PlaybackPairType
+{
+    uint16_t mark;
+    uint16_t space;
+} PlaybackPair;
+
+static PlaybackPair _queue[IRPLAYBACK_QUEUE_SIZE];
+static volatile uint8_t _head;
+static volatile uint8_t _tail;
+static volatile uint8_t _isActive;
+static volatile uint8_t _isFinished;
+static uint8_t _segment;
+static uint16_t _remaining;
+static uint16_t _spaceAfterMark;
+static IRCarrier _carrier;
+
+static uint16_t _microsToCycles(uint32_t micros)
+{
+    const uint32_t cycles = (micros * _carrier + 500) / 1000;
+    return (cycles > 0xFFFF) ? 0xFFFF : cycles;
+}
+
+void StartIRPlayback(IRCarrier carrier)
+{
+    // Segments are counted in carrier cycles so only the carrier period
+    // depends on the clock. Still run at full speed so the ISR keeps up.
+    setSystemClock(CLOCK_DIVISION_FULL);
+    const uint16_t top = (getSystemClockHz() / 1000UL) / carrier - 1;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        power_timer1_enable();
+        _head = 0;
+        _tail = 0;
+        _segment = _SEGMENT_IDLE;
+        _remaining = 0;
+        _isFinished = 0;
+        _isActive = 1;
+        _carrier = carrier;
+        TCCR1B = 0;
+        TCNT1 = 0;
+        ICR1 = top;
+        OCR1A = 0;
+        // ~33% duty cycle.
+        OCR1B = (top + 1) / 3;
+        // Fast PWM with ICR1 as TOP (mode 14), clk/1. OC1B stays disconnected
+        // until the first mark.
+        TCCR1A = _BV(WGM11);
+        TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS10);
+        CLEAR_INTERRUPT_FLAGS(TIFR1, _BV(OCF1A));
+        TIMSK1 = _BV(OCIE1A);
+    }
+}
+
+uint8_t QueueIRPlayback(uint32_t markMicros, uint32_t spaceMicros)
+{
+    uint8_t result = 0;
+    const uint16_t mark = _microsToCycles(markMicros);
+    const uint16_t space = _microsToCycles(spaceMicros);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        const uint8_t head = _head;
+        const uint8_t next = (head + 1) & _QUEUE_MASK;
+        if (next != _tail)
+        {
+            _queue[head].mark = mark ? mark : 1;
+            _queue[head].space = space;
+            _head = next;
+            result = 1;
+        }
+    }
+    return result;
+}
+
+uint8_t IsIRPlaybackQueueFull()
+{
+    return (((_head + 1) & _QUEUE_MASK) == _tail);
+}
+
+void FinishIRPlayback()
+{
+    _isFinished = 1;
+}
+
+uint8_t IsIRPlaybackActive()
+{
+    return _isActive;
+}
+
+void StopIRPlayback()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TIMSK1 = 0;
+        TCCR1A = 0;
+        TCCR1B = 0;
+        CLEAR_INTERRUPT_FLAGS(TIFR1, _BV(OCF1A));
+        PORTA &= ~(_BV(PINA_IR_OUT) | _BV(PINA_VISUAL));
+        power_timer1_disable();
+        _isActive = 0;
+    }
+}
+
+/**
+ * Runs once per carrier cycle (OCR1A matches at BOTTOM) so gating only ever
+ * happens on a period boundary.
+ */
+ISR(TIM1_COMPA_vect)
+{
+    if (_remaining && --_remaining)
+    {
+        return;
+    }
+
+    if (_SEGMENT_MARK == _segment && _spaceAfterMark)
+    {
+        _GATE_OFF();
+        _segment = _SEGMENT_SPACE;
+        _remaining = _spaceAfterMark;
+        return;
+    }
+
+    const uint8_t tail = _tail;
+    if (tail != _head)
+    {
+        _remaining = _queue[tail].mark;
+        _spaceAfterMark = _queue[tail].space;
+        _tail = (tail + 1) & _QUEUE_MASK;
+        _GATE_ON();
+        _segment = _SEGMENT_MARK;
+    }
+    else
+    {
+        _GATE_OFF();
+        _segment = _SEGMENT_IDLE;
+        if (_isFinished)
+        {
+            TIMSK1 = 0;
+            _isActive = 0;
+        }
+        // else the foreground fell behind. Hold the space until it catches up.
+    }
+}
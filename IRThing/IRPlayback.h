@@ -0,0 +1,75 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file IRPlayback.h
+ * Non-blocking IR transmitter. Timer1 generates the carrier in hardware on
+ * OC1B (PINA_IR_CARRIER) and the compare ISR gates it on and off at carrier
+ * period boundaries so marks and spaces are a whole number of carrier cycles.
+ * The foreground queues mark/space pairs as the ISR consumes them.
+ *
+ * Timer1 is shared with IRCapture. Only one of them may be started at a time.
+ */
+
+#ifndef IRPLAYBACK_H_
+#define IRPLAYBACK_H_
+
+#include "Framework.h"
+
+/**
+ * Number of mark/space pairs that can be queued ahead of the ISR. Must be a
+ * power of 2.
+ */
+#ifndef IRPLAYBACK_QUEUE_SIZE
+#define IRPLAYBACK_QUEUE_SIZE 4
+#endif
+
+// +--------------------------------------------------------------------------+
+// | CARRIERS (in kHz)
+// +--------------------------------------------------------------------------+
+#define IRPLAYBACK_CARRIER_36KHZ 36
+#define IRPLAYBACK_CARRIER_38KHZ 38
+#define IRPLAYBACK_CARRIER_40KHZ 40
+#define IRPLAYBACK_CARRIER_56KHZ 56
+
+typedef uint8_t IRCarrier;
+
+/**
+ * Power up Timer1 and start the carrier (gated off).
+ * \param  carrier  One of the IRPLAYBACK_CARRIER_XXXX values.
+ */
+void StartIRPlayback(IRCarrier carrier);
+
+/**
+ * Queue a mark followed by a space.
+ * \param  markMicros   Duration of the modulated mark.
+ * \param  spaceMicros  Duration of the following space. 0 to move directly to
+ *                      the next mark (used for the end of the transmission).
+ * \return 1 if the pair was queued, 0 if the queue is full.
+ */
+uint8_t QueueIRPlayback(uint32_t markMicros, uint32_t spaceMicros);
+
+/**
+ * \return 1 if QueueIRPlayback would fail.
+ */
+uint8_t IsIRPlaybackQueueFull();
+
+/**
+ * Tell the playback engine nothing more will be queued. Playback stops by
+ * itself once the queue drains.
+ */
+void FinishIRPlayback();
+
+/**
+ * \return 1 while there are marks or spaces left to transmit.
+ */
+uint8_t IsIRPlaybackActive();
+
+/**
+ * Abort any transmission in progress and power down Timer1.
+ */
+void StopIRPlayback();
+
+#endif /* IRPLAYBACK_H_ */
@@ -0,0 +1,735 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "IRProtocol.h"
+
+#define _CANDIDATE_NEC     0
+#define _CANDIDATE_SAMSUNG 1
+#define _CANDIDATE_SIRC    2
+#define _CANDIDATE_RC5     3
+#define _CANDIDATE_RC6     4
+
+#define _EDGE_FAILED 0xFF
+#define _EDGE_MAX    0xFE
+
+#define _FRAME_NONE   0
+#define _FRAME_CODE   1
+#define _FRAME_REPEAT 2
+
+// +--[ NEC / SAMSUNG ]-------------------------------------------------------+
+// Pulse distance. 32 bits LSB first: address, ~address (or address high
+// byte), command, ~command. Samsung repeats the address instead of inverting
+// it. NEC repeats with a short header and no data.
+#define _NEC_HEADER_MARK      9000
+#define _SAMSUNG_HEADER_MARK  4500
+#define _PD_HEADER_SPACE      4500
+#define _NEC_REPEAT_SPACE     2250
+#define _PD_BIT_MARK          560
+#define _PD_ZERO_SPACE        560
+#define _PD_ONE_SPACE         1690
+#define _PD_BITS              32
+#define _PD_FRAME_EDGES       (2 + (_PD_BITS * 2) + 1)
+#define _NEC_REPEAT_EDGES     3
+#define _PD_FRAME_MICROS      108000UL
+
+// +--[ SONY SIRC ]-----------------------------------------------------------+
+// Pulse width. 7 command bits then 5, 8 or 13 address bits, LSB first.
+#define _SIRC_HEADER_MARK     2400
+#define _SIRC_SPACE           600
+#define _SIRC_ZERO_MARK       600
+#define _SIRC_ONE_MARK        1200
+#define _SIRC_MAX_BITS        20
+#define _SIRC_FRAME_MICROS    45000UL
+
+// +--[ PHILIPS RC5 / RC6 ]---------------------------------------------------+
+// Manchester, MSB first. Timing is tracked in units of half a bit. RC5 is 14
+// bits (start, field, toggle, 5 address, 6 command) and a 1 is space then
+// mark. RC6 mode 0 is a leader then 21 bits (start, 3 mode, double width
+// trailer, 8 address, 8 command) and a 1 is mark then space.
+#define _RC5_UNIT             889
+#define _RC5_UNITS            28
+#define _RC5_BITS             14
+#define _RC5_FRAME_MICROS     113778UL
+#define _RC6_UNIT             444
+#define _RC6_LEADER_MARK      2666
+#define _RC6_LEADER_SPACE     889
+#define _RC6_UNITS            44
+#define _RC6_BITS             21
+#define _RC6_HEADER           0x8
+#define _RC6_FRAME_MICROS     106667UL
+
+#define _MIN_GAP_MICROS (IRPROTOCOL_FRAME_GAP_MICROS + (IRPROTOCOL_FRAME_GAP_MICROS / 4))
+
+#define _UNIT_FIRST  0
+#define _UNIT_SECOND 1
+#define _UNIT_HOLD   2
+#define _UNIT_END    3
+
+static uint8_t _matches(uint32_t micros, uint16_t nominal)
+{
+    const uint16_t tolerance = (nominal >> 2) + IRPROTOCOL_TOLERANCE_MICROS;
+    return (micros + tolerance >= nominal) && (micros <= (uint32_t)nominal + tolerance);
+}
+
+static inline void _fail(IRDecoderCandidate* c)
+{
+    c->edge = _EDGE_FAILED;
+}
+
+/**
+ * Classify a half bit unit position within a Manchester frame.
+ */
+static uint8_t _manchesterUnit(uint8_t candidate, uint8_t position)
+{
+    if (_CANDIDATE_RC5 == candidate)
+    {
+        return (position >= _RC5_UNITS) ? _UNIT_END : (position & 1);
+    }
+    if (position >= _RC6_UNITS)
+    {
+        return _UNIT_END;
+    }
+    if (position >= 8 && position < 12)
+    {
+        // Trailer bit is twice as wide as the others.
+        return (position & 1) ? _UNIT_HOLD : ((8 == position) ? _UNIT_FIRST : _UNIT_SECOND);
+    }
+    return position & 1;
+}
+
+static void _feedManchesterUnit(uint8_t candidate, IRDecoderCandidate* c, uint8_t isMark)
+{
+    switch(_manchesterUnit(candidate, c->half++))
+    {
+        case _UNIT_FIRST:
+        {
+            c->level = isMark;
+        }
+        break;
+        case _UNIT_HOLD:
+        {
+            if (isMark != c->level)
+            {
+                _fail(c);
+            }
+        }
+        break;
+        case _UNIT_SECOND:
+        {
+            if (isMark == c->level)
+            {
+                // No transition in the middle of the bit.
+                _fail(c);
+            }
+            else
+            {
+                const uint8_t bit = (_CANDIDATE_RC5 == candidate) ? isMark : !isMark;
+                c->bits = (c->bits << 1) | bit;
+                ++c->bitCount;
+                c->level = isMark;
+            }
+        }
+        break;
+        default:
+        {
+            _fail(c);
+        }
+        break;
+    }
+}
+
+static void _feedManchester(uint8_t candidate, IRDecoderCandidate* c, uint8_t isMark, uint16_t micros)
+{
+    if (_CANDIDATE_RC6 == candidate && c->edge < 2)
+    {
+        if (!_matches(micros, (0 == c->edge) ? _RC6_LEADER_MARK : _RC6_LEADER_SPACE))
+        {
+            _fail(c);
+        }
+        return;
+    }
+
+    const uint16_t unit = (_CANDIDATE_RC5 == candidate) ? _RC5_UNIT : _RC6_UNIT;
+    uint8_t units = 0;
+    for (uint8_t n = 1; n <= 3 && !units; ++n)
+    {
+        if (_matches(micros, unit * n))
+        {
+            units = n;
+        }
+    }
+    if (!units)
+    {
+        _fail(c);
+    }
+    while (units-- && _EDGE_FAILED != c->edge)
+    {
+        _feedManchesterUnit(candidate, c, isMark);
+    }
+}
+
+static void _feedPulseDistance(IRDecoderCandidate* c, uint8_t isMark, uint16_t micros, uint16_t headerMark, uint8_t hasRepeatFrame)
+{
+    const uint8_t edge = c->edge;
+    if (0 == edge)
+    {
+        if (!_matches(micros, headerMark))
+        {
+            _fail(c);
+        }
+    }
+    else if (1 == edge)
+    {
+        if (hasRepeatFrame && _matches(micros, _NEC_REPEAT_SPACE))
+        {
+            c->level = 1;
+        }
+        else if (!_matches(micros, _PD_HEADER_SPACE))
+        {
+            _fail(c);
+        }
+    }
+    else if (isMark)
+    {
+        if ((c->level && edge >= _NEC_REPEAT_EDGES) || !_matches(micros, _PD_BIT_MARK))
+        {
+            _fail(c);
+        }
+    }
+    else if (c->level || c->bitCount >= _PD_BITS)
+    {
+        _fail(c);
+    }
+    else if (_matches(micros, _PD_ONE_SPACE))
+    {
+        c->bits |= 1UL << c->bitCount++;
+    }
+    else if (_matches(micros, _PD_ZERO_SPACE))
+    {
+        ++c->bitCount;
+    }
+    else
+    {
+        _fail(c);
+    }
+}
+
+static void _feedPulseWidth(IRDecoderCandidate* c, uint8_t isMark, uint16_t micros)
+{
+    if (0 == c->edge)
+    {
+        if (!_matches(micros, _SIRC_HEADER_MARK))
+        {
+            _fail(c);
+        }
+    }
+    else if (!isMark)
+    {
+        if (!_matches(micros, _SIRC_SPACE))
+        {
+            _fail(c);
+        }
+    }
+    else if (c->bitCount >= _SIRC_MAX_BITS)
+    {
+        _fail(c);
+    }
+    else if (_matches(micros, _SIRC_ONE_MARK))
+    {
+        c->bits |= 1UL << c->bitCount++;
+    }
+    else if (_matches(micros, _SIRC_ZERO_MARK))
+    {
+        ++c->bitCount;
+    }
+    else
+    {
+        _fail(c);
+    }
+}
+
+static void _resetCandidates(IRDecoder* decoder)
+{
+    memset(decoder->_candidates, 0, sizeof(decoder->_candidates));
+    // RC5 frames start with the (invisible) space half of the start bit.
+    decoder->_candidates[_CANDIDATE_RC5].half = 1;
+    decoder->_hasFrame = 0;
+}
+
+/**
+ * \return _FRAME_NONE, _FRAME_REPEAT for an NEC repeat frame or _FRAME_CODE
+ *         with code populated.
+ */
+static uint8_t _decodeFrame(uint8_t candidate, IRDecoderCandidate* c, IRCode* code)
+{
+    if (_EDGE_FAILED == c->edge)
+    {
+        return _FRAME_NONE;
+    }
+
+    code->repeat = 0;
+    code->isExtended = 0;
+    switch(candidate)
+    {
+        case _CANDIDATE_NEC:
+        case _CANDIDATE_SAMSUNG:
+        {
+            if (c->level)
+            {
+                return (_NEC_REPEAT_EDGES == c->edge) ? _FRAME_REPEAT : _FRAME_NONE;
+            }
+            const uint8_t command = c->bits >> 16;
+            if (_PD_BITS != c->bitCount || _PD_FRAME_EDGES != c->edge || (uint8_t)~command != (uint8_t)(c->bits >> 24))
+            {
+                return _FRAME_NONE;
+            }
+            const uint8_t low = c->bits;
+            const uint8_t high = c->bits >> 8;
+            const uint8_t shortHigh = (_CANDIDATE_NEC == candidate) ? (uint8_t)(0xFF - low) : low;
+            code->protocol = (_CANDIDATE_NEC == candidate) ? IRPROTOCOL_NEC : IRPROTOCOL_SAMSUNG;
+            code->isExtended = (shortHigh != high);
+            code->address = code->isExtended ? (uint16_t)c->bits : low;
+            code->command = command;
+        }
+        break;
+        case _CANDIDATE_SIRC:
+        {
+            // The space after the last mark merged into the frame gap.
+            if (c->edge != (c->bitCount * 2) + 1)
+            {
+                return _FRAME_NONE;
+            }
+            switch(c->bitCount)
+            {
+                case 12: code->protocol = IRPROTOCOL_SIRC12; break;
+                case 15: code->protocol = IRPROTOCOL_SIRC15; break;
+                case 20: code->protocol = IRPROTOCOL_SIRC20; break;
+                default: return _FRAME_NONE;
+            }
+            code->address = c->bits >> 7;
+            code->command = c->bits & 0x7F;
+        }
+        break;
+        case _CANDIDATE_RC5:
+        case _CANDIDATE_RC6:
+        {
+            if (_UNIT_SECOND == _manchesterUnit(candidate, c->half))
+            {
+                // The last half bit was a space and merged into the frame gap.
+                _feedManchesterUnit(candidate, c, 0);
+            }
+            if (_CANDIDATE_RC5 == candidate)
+            {
+                if (_RC5_UNITS != c->half || _RC5_BITS != c->bitCount || !(c->bits >> 13))
+                {
+                    return _FRAME_NONE;
+                }
+                code->protocol = IRPROTOCOL_RC5;
+                code->address = (c->bits >> 6) & 0x1F;
+                // RC5X uses the inverted field bit as the 7th command bit.
+                code->command = (c->bits & 0x3F) | (((c->bits >> 12) & 1) ? 0 : 0x40);
+            }
+            else
+            {
+                if (_RC6_UNITS != c->half || _RC6_BITS != c->bitCount || _RC6_HEADER != (c->bits >> 17))
+                {
+                    return _FRAME_NONE;
+                }
+                code->protocol = IRPROTOCOL_RC6;
+                code->address = (c->bits >> 8) & 0xFF;
+                code->command = c->bits & 0xFF;
+            }
+        }
+        break;
+        default:
+            return _FRAME_NONE;
+    }
+    return _FRAME_CODE;
+}
+
+static void _endFrame(IRDecoder* decoder)
+{
+    IRCode frame;
+    uint8_t result = _FRAME_NONE;
+    for (uint8_t i = 0; i < _IRDECODER_CANDIDATES && _FRAME_NONE == result; ++i)
+    {
+        result = _decodeFrame(i, &decoder->_candidates[i], &frame);
+    }
+
+    IRCode* code = &decoder->code;
+    if (_FRAME_NONE == result)
+    {
+        decoder->_isUnknown = 1;
+    }
+    else if (_FRAME_REPEAT == result)
+    {
+        if (IRPROTOCOL_NEC != code->protocol)
+        {
+            decoder->_isUnknown = 1;
+        }
+        else if (code->repeat < 0xFF)
+        {
+            ++code->repeat;
+        }
+    }
+    else if (IRPROTOCOL_UNKNOWN == code->protocol)
+    {
+        *code = frame;
+    }
+    else if (frame.protocol == code->protocol && frame.address == code->address && frame.command == code->command &&
+             frame.isExtended == code->isExtended)
+    {
+        if (code->repeat < 0xFF)
+        {
+            ++code->repeat;
+        }
+    }
+    else
+    {
+        // More than one code in the capture.
+        decoder->_isUnknown = 1;
+    }
+    _resetCandidates(decoder);
+}
+
+// +--------------------------------------------------------------------------+
+// | DECODER
+// +--------------------------------------------------------------------------+
+IRDecoder* IRDecoderInit(IRDecoder* decoder)
+{
+    if (decoder)
+    {
+        memset(&decoder->code, 0, sizeof(decoder->code));
+        decoder->_isUnknown = 0;
+        _resetCandidates(decoder);
+    }
+    return decoder;
+}
+
+void FeedIRDecoder(IRDecoder* decoder, uint8_t isMark, uint16_t micros)
+{
+    if (!isMark)
+    {
+        if (!decoder->_hasFrame)
+        {
+            // Silence between frames.
+            return;
+        }
+        if (micros > IRPROTOCOL_FRAME_GAP_MICROS)
+        {
+            _endFrame(decoder);
+            return;
+        }
+    }
+    decoder->_hasFrame = 1;
+
+    for (uint8_t i = 0; i < _IRDECODER_CANDIDATES; ++i)
+    {
+        IRDecoderCandidate* c = &decoder->_candidates[i];
+        if (_EDGE_FAILED == c->edge)
+        {
+            continue;
+        }
+        switch(i)
+        {
+            case _CANDIDATE_NEC:
+                _feedPulseDistance(c, isMark, micros, _NEC_HEADER_MARK, 1);
+                break;
+            case _CANDIDATE_SAMSUNG:
+                _feedPulseDistance(c, isMark, micros, _SAMSUNG_HEADER_MARK, 0);
+                break;
+            case _CANDIDATE_SIRC:
+                _feedPulseWidth(c, isMark, micros);
+                break;
+            default:
+                _feedManchester(i, c, isMark, micros);
+                break;
+        }
+        if (c->edge < _EDGE_MAX)
+        {
+            ++c->edge;
+        }
+    }
+}
+
+uint8_t FinishIRDecoder(IRDecoder* decoder, IRCode* code)
+{
+    if (decoder->_hasFrame)
+    {
+        _endFrame(decoder);
+    }
+    if (decoder->_isUnknown || IRPROTOCOL_UNKNOWN == decoder->code.protocol)
+    {
+        return 0;
+    }
+    *code = decoder->code;
+    return 1;
+}
+
+uint8_t IsIRDecoderRepeating(const IRDecoder* decoder)
+{
+    return (!decoder->_isUnknown && IRPROTOCOL_UNKNOWN != decoder->code.protocol && decoder->code.repeat);
+}
+
+// +--------------------------------------------------------------------------+
+// | ENCODER
+// +--------------------------------------------------------------------------+
+static uint32_t _framePeriodMicros(IRProtocol protocol)
+{
+    switch(protocol)
+    {
+        case IRPROTOCOL_NEC:
+        case IRPROTOCOL_SAMSUNG:
+            return _PD_FRAME_MICROS;
+        case IRPROTOCOL_RC5:
+            return _RC5_FRAME_MICROS;
+        case IRPROTOCOL_RC6:
+            return _RC6_FRAME_MICROS;
+        default:
+            return _SIRC_FRAME_MICROS;
+    }
+}
+
+/**
+ * Generate one segment of the current frame. Consecutive segments may have
+ * the same level.
+ * \return 0 if step is past the end of the frame.
+ */
+static uint8_t _frameSegment(IREncoder* encoder, uint8_t step, uint8_t* isMark, uint32_t* micros)
+{
+    const IRProtocol protocol = encoder->code.protocol;
+    const uint32_t bits = encoder->_bits;
+    switch(protocol)
+    {
+        case IRPROTOCOL_NEC:
+        case IRPROTOCOL_SAMSUNG:
+        {
+            const uint8_t isRepeatFrame = (IRPROTOCOL_NEC == protocol && encoder->_frame);
+            if (step >= (isRepeatFrame ? _NEC_REPEAT_EDGES : _PD_FRAME_EDGES))
+            {
+                return 0;
+            }
+            *isMark = !(step & 1);
+            if (0 == step)
+            {
+                *micros = (IRPROTOCOL_NEC == protocol) ? _NEC_HEADER_MARK : _SAMSUNG_HEADER_MARK;
+            }
+            else if (1 == step)
+            {
+                *micros = isRepeatFrame ? _NEC_REPEAT_SPACE : _PD_HEADER_SPACE;
+            }
+            else if (*isMark)
+            {
+                *micros = _PD_BIT_MARK;
+            }
+            else
+            {
+                *micros = ((bits >> ((step - 3) >> 1)) & 1) ? _PD_ONE_SPACE : _PD_ZERO_SPACE;
+            }
+        }
+        break;
+        case IRPROTOCOL_SIRC12:
+        case IRPROTOCOL_SIRC15:
+        case IRPROTOCOL_SIRC20:
+        {
+            const uint8_t bitCount = (IRPROTOCOL_SIRC12 == protocol) ? 12 : ((IRPROTOCOL_SIRC15 == protocol) ? 15 : 20);
+            if (step > bitCount * 2)
+            {
+                return 0;
+            }
+            *isMark = !(step & 1);
+            if (0 == step)
+            {
+                *micros = _SIRC_HEADER_MARK;
+            }
+            else if (*isMark)
+            {
+                *micros = ((bits >> ((step - 2) >> 1)) & 1) ? _SIRC_ONE_MARK : _SIRC_ZERO_MARK;
+            }
+            else
+            {
+                *micros = _SIRC_SPACE;
+            }
+        }
+        break;
+        case IRPROTOCOL_RC5:
+        {
+            if (step >= _RC5_UNITS)
+            {
+                return 0;
+            }
+            const uint8_t bit = (bits >> (_RC5_BITS - 1 - (step >> 1))) & 1;
+            *isMark = (step & 1) ? bit : !bit;
+            *micros = _RC5_UNIT;
+        }
+        break;
+        case IRPROTOCOL_RC6:
+        {
+            if (step < 2)
+            {
+                *isMark = !step;
+                *micros = step ? _RC6_LEADER_SPACE : _RC6_LEADER_MARK;
+                break;
+            }
+            const uint8_t position = step - 2;
+            if (position >= _RC6_UNITS)
+            {
+                return 0;
+            }
+            uint8_t index;
+            uint8_t isSecond;
+            if (position < 8)
+            {
+                index = position >> 1;
+                isSecond = position & 1;
+            }
+            else if (position < 12)
+            {
+                index = 4;
+                isSecond = (position >= 10);
+            }
+            else
+            {
+                index = 5 + ((position - 12) >> 1);
+                isSecond = position & 1;
+            }
+            const uint8_t bit = (bits >> (_RC6_BITS - 1 - index)) & 1;
+            *isMark = isSecond ? !bit : bit;
+            *micros = _RC6_UNIT;
+        }
+        break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+static uint8_t _nextSegment(IREncoder* encoder, uint8_t* isMark, uint32_t* micros)
+{
+    if (_frameSegment(encoder, encoder->_step, isMark, micros))
+    {
+        ++encoder->_step;
+        encoder->_frameMicros += *micros;
+        return 1;
+    }
+    if (encoder->_frame >= encoder->code.repeat)
+    {
+        return 0;
+    }
+
+    // Pad out to the protocol's frame period before the next frame.
+    const uint32_t period = _framePeriodMicros(encoder->code.protocol);
+    *isMark = 0;
+    *micros = (period > encoder->_frameMicros + _MIN_GAP_MICROS) ? period - encoder->_frameMicros : _MIN_GAP_MICROS;
+    ++encoder->_frame;
+    encoder->_step = 0;
+    encoder->_frameMicros = 0;
+    return 1;
+}
+
+IREncoder* IREncoderInit(IREncoder* encoder, const IRCode* code)
+{
+    if (!encoder || !code)
+    {
+        return 0;
+    }
+
+    const uint16_t address = code->address;
+    const uint8_t command = code->command;
+    const uint32_t commandBits = ((uint32_t)command << 16) | ((uint32_t)(uint8_t)~command << 24);
+    switch(code->protocol)
+    {
+        case IRPROTOCOL_NEC:
+            encoder->_bits = commandBits | (code->isExtended ? address : ((address & 0xFF) | ((~address & 0xFF) << 8)));
+            break;
+        case IRPROTOCOL_SAMSUNG:
+            encoder->_bits = commandBits | (code->isExtended ? address : ((address & 0xFF) | ((address & 0xFF) << 8)));
+            break;
+        case IRPROTOCOL_SIRC12:
+        case IRPROTOCOL_SIRC15:
+        case IRPROTOCOL_SIRC20:
+            encoder->_bits = (command & 0x7F) | ((uint32_t)address << 7);
+            break;
+        case IRPROTOCOL_RC5:
+            encoder->_bits = (1UL << 13) | ((command & 0x40) ? 0 : (1UL << 12)) | ((uint32_t)(address & 0x1F) << 6) | (command & 0x3F);
+            break;
+        case IRPROTOCOL_RC6:
+            encoder->_bits = ((uint32_t)_RC6_HEADER << 17) | ((uint32_t)(address & 0xFF) << 8) | command;
+            break;
+        default:
+            return 0;
+    }
+    encoder->code = *code;
+    encoder->_frameMicros = 0;
+    encoder->_frame = 0;
+    encoder->_step = 0;
+    encoder->_hasPending = 0;
+    return encoder;
+}
+
+uint8_t NextIREncoderPair(IREncoder* encoder, uint32_t* markMicros, uint32_t* spaceMicros)
+{
+    uint32_t mark = 0;
+    uint32_t space = 0;
+    uint8_t isMark;
+    uint32_t micros;
+    while (1)
+    {
+        if (encoder->_hasPending)
+        {
+            isMark = encoder->_isPendingMark;
+            micros = encoder->_pendingMicros;
+            encoder->_hasPending = 0;
+        }
+        else if (!_nextSegment(encoder, &isMark, &micros))
+        {
+            // Don't hold the line after the last mark.
+            space = 0;
+            break;
+        }
+
+        if (isMark)
+        {
+            if (space)
+            {
+                encoder->_isPendingMark = 1;
+                encoder->_pendingMicros = micros;
+                encoder->_hasPending = 1;
+                break;
+            }
+            mark += micros;
+        }
+        else if (mark)
+        {
+            space += micros;
+        }
+        // else a space before the first mark. Nothing to transmit.
+    }
+
+    if (!mark)
+    {
+        return 0;
+    }
+    *markMicros = mark;
+    *spaceMicros = space;
+    return 1;
+}
+
+IRCarrier GetIRProtocolCarrier(IRProtocol protocol)
+{
+    switch(protocol)
+    {
+        case IRPROTOCOL_SIRC12:
+        case IRPROTOCOL_SIRC15:
+        case IRPROTOCOL_SIRC20:
+            return IRPLAYBACK_CARRIER_40KHZ;
+        case IRPROTOCOL_RC5:
+        case IRPROTOCOL_RC6:
+            return IRPLAYBACK_CARRIER_36KHZ;
+        default:
+            return IRPLAYBACK_CARRIER_38KHZ;
+    }
+}
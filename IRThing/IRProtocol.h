@@ -0,0 +1,176 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file IRProtocol.h
+ * Decoders and encoders for common consumer IR protocols. The decoder is fed
+ * marks and spaces as they are captured and runs every protocol's state
+ * machine side by side so nothing has to be buffered. The encoder turns a
+ * decoded IRCode back into mark/space pairs on demand for IRPlayback.
+ */
+
+#ifndef IRPROTOCOL_H_
+#define IRPROTOCOL_H_
+
+#include "Framework.h"
+#include "IRPlayback.h"
+
+// +--------------------------------------------------------------------------+
+// | PROTOCOLS
+// +--------------------------------------------------------------------------+
+#define IRPROTOCOL_UNKNOWN 0
+#define IRPROTOCOL_NEC     1
+#define IRPROTOCOL_SAMSUNG 2
+#define IRPROTOCOL_SIRC12  3
+#define IRPROTOCOL_SIRC15  4
+#define IRPROTOCOL_SIRC20  5
+#define IRPROTOCOL_RC5     6
+#define IRPROTOCOL_RC6     7
+
+typedef uint8_t IRProtocol;
+
+/**
+ * Spaces longer than this end a frame. Long SIRC20 frames leave less than
+ * 7ms before the next one.
+ */
+#define IRPROTOCOL_FRAME_GAP_MICROS 6000
+
+/**
+ * Slack allowed on every nominal duration on top of 25%. IR receivers
+ * typically stretch marks and shorten spaces by up to this much.
+ */
+#define IRPROTOCOL_TOLERANCE_MICROS 50
+
+/**
+ * \struct IRCode
+ * A decoded IR transmission.
+ */
+typedef struct _IRCodeType
+{
+    /**
+     * One of the IRPROTOCOL_XXXX values.
+     */
+    IRProtocol protocol;
+
+    /**
+     * Number of times the code was repeated after the first frame (held
+     * button).
+     */
+    uint8_t repeat;
+
+    /**
+     * Device address. 16 bits for extended NEC and Samsung, 13 for SIRC20,
+     * otherwise 8 or less.
+     */
+    uint16_t address;
+
+    uint8_t command;
+
+    /**
+     * 1 if the NEC or Samsung address was sent as 16 bits rather than 8 bits
+     * and its check byte. Needed to resend addresses with a 0 high byte.
+     */
+    uint8_t isExtended;
+} IRCode;
+
+/**
+ * Per protocol decoding state. Private.
+ */
+typedef struct _IRDecoderCandidateType
+{
+    uint32_t bits;
+    uint8_t edge;
+    uint8_t half;
+    uint8_t bitCount;
+    uint8_t level;
+} IRDecoderCandidate;
+
+#define _IRDECODER_CANDIDATES 5
+
+/**
+ * \struct IRDecoder
+ * Incremental decoder for all supported protocols.
+ */
+typedef struct _IRDecoderType
+{
+    IRCode code;
+    IRDecoderCandidate _candidates[_IRDECODER_CANDIDATES];
+    uint8_t _hasFrame;
+    uint8_t _isUnknown;
+} IRDecoder;
+
+/**
+ * \struct IREncoder
+ * Generates the waveform for an IRCode a mark/space pair at a time.
+ */
+typedef struct _IREncoderType
+{
+    IRCode code;
+    uint32_t _bits;
+    uint32_t _frameMicros;
+    uint32_t _pendingMicros;
+    uint8_t _frame;
+    uint8_t _step;
+    uint8_t _hasPending;
+    uint8_t _isPendingMark;
+} IREncoder;
+
+/**
+ * Objective-C style decoder initializer. Readies the decoder for a new
+ * transmission.
+ * \param  decoder  The decoder to initialize.
+ * \return A pointer to the initialized decoder.
+ */
+IRDecoder* IRDecoderInit(IRDecoder* decoder);
+
+/**
+ * Feed the next mark or space of a transmission. The transmission must start
+ * with a mark.
+ * \param  decoder  The decoder to feed.
+ * \param  isMark   1 if the IR carrier was present for the duration.
+ * \param  micros   Duration of the mark or space.
+ */
+void FeedIRDecoder(IRDecoder* decoder, uint8_t isMark, uint16_t micros);
+
+/**
+ * Call once the transmission has ended.
+ * \param  decoder  The decoder that was fed the transmission.
+ * \param  code     Populated with the decoded code if successful.
+ * \return 1 if every frame in the transmission decoded to the same code.
+ */
+uint8_t FinishIRDecoder(IRDecoder* decoder, IRCode* code);
+
+/**
+ * \param  decoder  The decoder being fed a transmission.
+ * \return 1 if every frame so far decoded to the same code and it has already
+ *         been repeated (a repeat frame or the same frame again).
+ */
+uint8_t IsIRDecoderRepeating(const IRDecoder* decoder);
+
+/**
+ * Objective-C style encoder initializer.
+ * \param  encoder  The encoder to initialize.
+ * \param  code     The code to transmit. Copied.
+ * \return A pointer to the initialized encoder or 0 if the code's protocol
+ *         isn't supported.
+ */
+IREncoder* IREncoderInit(IREncoder* encoder, const IRCode* code);
+
+/**
+ * Generate the next mark and the space following it.
+ * \param  encoder      The encoder.
+ * \param  markMicros   Populated with the duration of the mark.
+ * \param  spaceMicros  Populated with the duration of the space. 0 after the
+ *                      last mark.
+ * \return 0 once the transmission is complete (nothing populated).
+ */
+uint8_t NextIREncoderPair(IREncoder* encoder, uint32_t* markMicros, uint32_t* spaceMicros);
+
+/**
+ * \return The carrier a protocol is modulated with.
+ */
+IRCarrier GetIRProtocolCarrier(IRProtocol protocol);
+
+#endif /* IRPROTOCOL_H_ */
@@ -6,8 +6,70 @@
 
 #include "Indicator.h"
 
-static void _OnIndicatorAnimate(Indicator* indicator, uint16_t timeElapsedMillis);
+// +--------------------------------------------------------------------------+
+// | ANIMATIONS
+// +--------------------------------------------------------------------------+
+static const IndicatorKeyframe _animationOn[] TINKER_PROGMEM = {
+    INDICATOR_STOP(INDICATOR_LEVEL_ON),
+};
 
+static const IndicatorKeyframe _animationBlinkOn[] TINKER_PROGMEM = {
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 500),
+    INDICATOR_KEY(INDICATOR_LEVEL_ON, 300),
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 100),
+    INDICATOR_STOP(INDICATOR_LEVEL_ON),
+};
+
+static const IndicatorKeyframe _animationBlinkOff[] TINKER_PROGMEM = {
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 250),
+    INDICATOR_KEY(INDICATOR_LEVEL_ON, 250),
+    INDICATOR_STOP(INDICATOR_LEVEL_OFF),
+};
+
+static const IndicatorKeyframe _animationBlink[] TINKER_PROGMEM = {
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 100),
+    INDICATOR_KEY(INDICATOR_LEVEL_ON, 100),
+    INDICATOR_LOOP(0),
+};
+
+static const IndicatorKeyframe _animationWink[] TINKER_PROGMEM = {
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 75),
+    INDICATOR_KEY(INDICATOR_LEVEL_ON, 1500),
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 75),
+    INDICATOR_KEY(INDICATOR_LEVEL_ON, 100),
+    INDICATOR_LOOP(0),
+};
+
+static const IndicatorKeyframe _animationOff[] TINKER_PROGMEM = {
+    INDICATOR_STOP(INDICATOR_LEVEL_OFF),
+};
+
+/**
+ * Blinks repeats + 1 times (see SetIndicatorModeWRepeats) between pauses.
+ */
+static const IndicatorKeyframe _animationCode[] TINKER_PROGMEM = {
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 500),
+    INDICATOR_KEY(INDICATOR_LEVEL_ON, 110),
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 90),
+    INDICATOR_REPEAT(1),
+    INDICATOR_KEY(INDICATOR_LEVEL_OFF, 500),
+    INDICATOR_STOP(INDICATOR_LEVEL_OFF),
+};
+
+static const IndicatorKeyframe* const _animations[INDICATORMODE_COUNT] TINKER_PROGMEM = {
+    [INDICATORMODE_NONE] = 0,
+    [INDICATORMODE_ON] = _animationOn,
+    [INDICATORMODE_BLINK_ON] = _animationBlinkOn,
+    [INDICATORMODE_BLINK_OFF] = _animationBlinkOff,
+    [INDICATORMODE_BLINK] = _animationBlink,
+    [INDICATORMODE_WINK] = _animationWink,
+    [INDICATORMODE_OFF] = _animationOff,
+    [INDICATORMODE_CODE] = _animationCode,
+};
+
+// +--------------------------------------------------------------------------+
+// | ENGINE
+// +--------------------------------------------------------------------------+
 static inline void _changeState(Indicator* indicator, IndicatorState newState)
 {
     if (newState != indicator->_state)
@@ -20,40 +82,135 @@ static inline void _changeState(Indicator* indicator, IndicatorState newState)
     }
 }
 
-static uint8_t _HandlePortMessage(RunLoopPort* port, RunLoop* runLoop, RunLoopMessageType messageType, RunLoopMessageData data)
+/**
+ * Start a keyframe (following loop and repeat markers first) and set how long
+ * until it next needs attention. Markers must lead to a step or stop.
+ */
+static void _enterKeyframe(Indicator* indicator, const IndicatorKeyframe* keyframe)
 {
-    if (RUNLOOP_MESSAGE_FRAME == messageType)
+    uint8_t frames = TINKER_READ_BYTE(&keyframe->frames);
+    while (INDICATOR_FRAMES_LOOP == frames || INDICATOR_FRAMES_REPEAT == frames)
     {
-        _OnIndicatorAnimate((Indicator*)port->userData, data);
-        return 1;
+        if (INDICATOR_FRAMES_REPEAT == frames && 0 == indicator->_repeatsLeft)
+        {
+            ++keyframe;
+        }
+        else
+        {
+            if (INDICATOR_FRAMES_REPEAT == frames)
+            {
+                --indicator->_repeatsLeft;
+            }
+            keyframe = &indicator->_animation[TINKER_READ_BYTE(&keyframe->level)];
+        }
+        frames = TINKER_READ_BYTE(&keyframe->frames);
+    }
+    indicator->_keyframe = keyframe;
+    _changeState(indicator, TINKER_READ_BYTE(&keyframe->level) ? INDICATORSTATE_ON : INDICATORSTATE_OFF);
+    if (INDICATOR_FRAMES_STOP == frames)
+    {
+        indicator->_keyframe = 0;
+        indicator->_millisLeft = 0;
+        _changeState(indicator, INDICATORSTATE_STOPPED);
+    }
+    else
+    {
+        // Nothing changes until the end of a step so sleep through it.
+        indicator->_millisLeft = (uint16_t)frames * INDICATOR_FRAME_MILLIS;
     }
-    return 0;
 }
 
-void SetIndicatorMode(Indicator* indicator, IndicatorMode mode)
+static void _onIndicatorFrame(Indicator* indicator)
+{
+    _enterKeyframe(indicator, indicator->_keyframe + 1);
+}
+
+// +--------------------------------------------------------------------------+
+// | FRAME TIMER
+// +--------------------------------------------------------------------------+
+/**
+ * Every indicator shares one timer, armed for whichever needs attention
+ * first. _scheduledMillis is what it was armed with so the time that has
+ * passed since can be worked out without a timer per indicator.
+ */
+static Indicator* _indicators[INDICATOR_MAX_INDICATORS];
+static uint8_t _indicatorCount;
+static uint16_t _scheduledMillis;
+static Timer _frameTimer;
+
+/**
+ * Count every animating indicator down by the time since the frame timer was
+ * armed and run the frames that are due. One pass for all of them.
+ */
+static void _advanceIndicators()
+{
+    const uint16_t remaining = GetTimerRemaining(&mainTimerService, &_frameTimer);
+    const uint16_t elapsed = _scheduledMillis - remaining;
+    // Callbacks may set modes. Don't let them count this time again.
+    _scheduledMillis = remaining;
+    for (uint8_t i = 0; i < _indicatorCount; ++i)
+    {
+        Indicator* indicator = _indicators[i];
+        if (indicator->_keyframe)
+        {
+            indicator->_millisLeft = (indicator->_millisLeft > elapsed) ? indicator->_millisLeft - elapsed : 0;
+            if (0 == indicator->_millisLeft)
+            {
+                _onIndicatorFrame(indicator);
+            }
+        }
+    }
+}
+
+static void _scheduleFrameTimer()
+{
+    uint16_t next = 0;
+    for (uint8_t i = 0; i < _indicatorCount; ++i)
+    {
+        const Indicator* indicator = _indicators[i];
+        if (indicator->_keyframe && (0 == next || indicator->_millisLeft < next))
+        {
+            next = indicator->_millisLeft;
+        }
+    }
+    _scheduledMillis = next;
+    if (next)
+    {
+        ScheduleTimer(&mainTimerService, &_frameTimer, next, 0);
+    }
+    else
+    {
+        CancelTimer(&mainTimerService, &_frameTimer);
+    }
+}
+
+static void _OnIndicatorFrameTimer(Timer* timer)
+{
+    _advanceIndicators();
+    _scheduleFrameTimer();
+}
+
+void SetIndicatorModeWRepeats(Indicator* indicator, IndicatorMode mode, uint8_t repeats)
 {
     if(indicator)
     {
         IndicatorMode oldMode = indicator->_mode;
+        // Bring the others up to now so the new mode's timing starts from here.
+        _advanceIndicators();
         indicator->_mode = mode;
-        indicator->_time = 0;
-        indicator->_phase = 0;
-        switch(mode) {
-            case INDICATORMODE_BLINK_ON:
-            case INDICATORMODE_BLINK_OFF:
-            case INDICATORMODE_OFF:
-            case INDICATORMODE_BLINK:
-            case INDICATORMODE_WINK:
-            _changeState(indicator, INDICATORSTATE_OFF);
-            asm("nop");
-            break;
+        indicator->_repeatsLeft = repeats;
+        indicator->_animation = (mode < INDICATORMODE_COUNT) ? (const IndicatorKeyframe*)TINKER_READ_PTR(&_animations[mode]) : 0;
+        if (indicator->_animation)
+        {
+            _enterKeyframe(indicator, indicator->_animation);
         }
-        switch(mode) {
-            case INDICATORMODE_ON:
-            _changeState(indicator, INDICATORSTATE_ON);
-            asm("nop");
-            break;
+        else
+        {
+            indicator->_keyframe = 0;
+            indicator->_millisLeft = 0;
+            _changeState(indicator, INDICATORSTATE_STOPPED);
         }
+        _scheduleFrameTimer();
         if (indicator->_onmodeChange)
         {
             indicator->_onmodeChange(indicator, oldMode, mode);
@@ -61,6 +218,11 @@ void SetIndicatorMode(Indicator* indicator, IndicatorMode mode)
     }
 }
 
+void SetIndicatorMode(Indicator* indicator, IndicatorMode mode)
+{
+    SetIndicatorModeWRepeats(indicator, mode, 0);
+}
+
 IndicatorMode GetIndicatorMode(Indicator* indicator)
 {
     IndicatorMode result = INDICATORMODE_NONE;
@@ -110,173 +272,28 @@ IndicatorMode PopIndicatorMode(Indicator* indicator)
     return result;
 }
 
-Indicator* IndicatorInit(Indicator* newIndicator, OnIndicatorModeChangeFunc onModeChange , OnIndicatorStateChangeFunc onStateChange)
+Indicator* IndicatorInit(Indicator* newIndicator, OnIndicatorModeChangeFunc onModeChange, OnIndicatorStateChangeFunc onStateChange)
 {
-    if (newIndicator)
+    if (newIndicator && INDICATOR_MAX_INDICATORS == _indicatorCount)
     {
+        newIndicator = 0;
+    }
+    else if (newIndicator)
+    {
+        if (0 == _indicatorCount)
+        {
+            TimerInit(&_frameTimer, _OnIndicatorFrameTimer);
+        }
+        _indicators[_indicatorCount++] = newIndicator;
         newIndicator->_mode = INDICATORMODE_NONE;
         newIndicator->_state = INDICATORSTATE_STOPPED;
         newIndicator->_modeStackLen = 0;
-        newIndicator->_time = 0;
-        newIndicator->_phase = 0;
+        newIndicator->_animation = 0;
+        newIndicator->_keyframe = 0;
+        newIndicator->_repeatsLeft = 0;
+        newIndicator->_millisLeft = 0;
         newIndicator->_onmodeChange = onModeChange;
         newIndicator->_onstateChange = onStateChange;
-        InitRunLoopPort(&newIndicator->_port, _HandlePortMessage);
-        newIndicator->_port.userData = newIndicator;
-        AddPort(&mainRunLoop, &newIndicator->_port);
-        // TODO: if RUNLOOP_MAX_PORTS == AddPort then goto blink firmware error
     }
     return newIndicator;
 }
-
-static void _OnIndicatorAnimate(Indicator* indicator, uint16_t timeElapsedMillis)
-{
-    if (!indicator)
-    {
-        return;
-    }
-    
-    indicator->_time += timeElapsedMillis;
-    switch(indicator->_mode)
-    {
-        case INDICATORMODE_ON:
-        {
-            _changeState(indicator, INDICATORSTATE_ON);
-            asm("nop");
-            _changeState(indicator, INDICATORSTATE_STOPPED);
-        }
-        break;
-        case INDICATORMODE_BLINK_ON:
-        {
-            if (0 == indicator->_phase)
-            {
-                if (indicator->_time >= 500)
-                {
-                    _changeState(indicator, INDICATORSTATE_ON);
-                    ++indicator->_phase;
-                    indicator->_time = 0;
-                }
-            }
-            else if (1 == indicator->_phase)
-            {
-                if (indicator->_time >= 300)
-                {
-                    _changeState(indicator, INDICATORSTATE_OFF);
-                    indicator->_time = 0;
-                    ++indicator->_phase;
-                }
-            }
-            else
-            {
-                if (indicator->_time >= 100)
-                {
-                    _changeState(indicator, INDICATORSTATE_ON);
-                    asm("nop");
-                    _changeState(indicator, INDICATORSTATE_STOPPED);
-                }
-            }
-        }
-        break;
-        case INDICATORMODE_BLINK_OFF:
-        {
-            if (0 == indicator->_phase)
-            {
-                if (indicator->_time >= 250)
-                {
-                    _changeState(indicator, INDICATORSTATE_ON);
-                    indicator->_time = 0;
-                    ++indicator->_phase;
-                }
-            }
-            else if (indicator->_time >= 250)
-            {
-                _changeState(indicator, INDICATORSTATE_OFF);
-                asm("nop");
-                _changeState(indicator, INDICATORSTATE_STOPPED);
-            }
-        }
-        break;
-        case INDICATORMODE_BLINK:
-        {
-            if (0 == indicator->_phase)
-            {
-                if (indicator->_time >= 100)
-                {
-                    _changeState(indicator, INDICATORSTATE_ON);
-                    indicator->_time = 0;
-                    ++indicator->_phase;
-                }
-            }
-            else if (indicator->_time >= 100)
-            {
-                _changeState(indicator, INDICATORSTATE_OFF);
-                indicator->_time = 0;
-                indicator->_phase = 0;
-            }
-        }
-        break;
-        case INDICATORMODE_WINK:
-        {
-            switch (indicator->_phase)
-            {
-                case 0:
-                {
-                    // On long
-                    if (indicator->_time >= 75)
-                    {
-                        _changeState(indicator, INDICATORSTATE_ON);
-                        indicator->_time = 0;
-                        indicator->_phase++;
-                    }
-                }
-                break;
-                case 1:
-                {
-                    // wink off
-                    if (indicator->_time >= 1500)
-                    {
-                        _changeState(indicator, INDICATORSTATE_OFF);
-                        indicator->_time = 0;
-                        indicator->_phase++;
-                    }
-                }
-                break;
-                case 2:
-                {
-                    // wink on
-                    if (indicator->_time >= 75)
-                    {
-                        _changeState(indicator, INDICATORSTATE_ON);
-                        indicator->_time = 0;
-                        indicator->_phase++;
-                    }
-                }
-                break;
-                case 3:
-                {
-                    // wink off
-                    if (indicator->_time >= 100)
-                    {
-                        _changeState(indicator, INDICATORSTATE_OFF);
-                        indicator->_time = 0;
-                        indicator->_phase = 0;
-                    }
-                }
-                break;
-            }
-        }
-        break;
-        case INDICATORMODE_OFF:
-        {
-            _changeState(indicator, INDICATORSTATE_OFF);
-            asm("nop");
-            _changeState(indicator, INDICATORSTATE_STOPPED);
-        }
-        break;
-        case INDICATORMODE_NONE:
-        {
-            _changeState(indicator, INDICATORSTATE_STOPPED);
-        }
-        break;
-    }
-}
@@ -9,21 +9,84 @@
 #define INDICATOR_H_
 
 #include "Framework.h"
-#include "tinker/RunLoop.h"
+#include "tinker/Timer.h"
+#include "tinker/Platform.h"
 
-#define INDICATORMODE_NONE 0
-#define INDICATORMODE_ON 1
-#define INDICATORMODE_BLINK_ON 2
-#define INDICATORMODE_BLINK_OFF 3
+/**
+ * Modes index the animation table in Indicator.c.
+ */
+#define INDICATORMODE_NONE 0
+#define INDICATORMODE_ON 1
+#define INDICATORMODE_BLINK_ON 2
+#define INDICATORMODE_BLINK_OFF 3
 #define INDICATORMODE_BLINK 4
 #define INDICATORMODE_WINK 5
-#define INDICATORMODE_OFF 0xFF
+#define INDICATORMODE_OFF 6
+#define INDICATORMODE_CODE 7
+#define INDICATORMODE_COUNT 8
 
 #define INDICATORSTATE_STOPPED 0
 #define INDICATORSTATE_OFF 1
 #define INDICATORSTATE_ON 2
 
 #define INDICATOR_MODE_STACK_SIZE 2
+#define INDICATOR_FRAME_MILLIS 16
+
+/**
+ * All indicators are animated in one pass from one timer. This is how many
+ * can be initialized.
+ */
+#ifndef INDICATOR_MAX_INDICATORS
+#define INDICATOR_MAX_INDICATORS 2
+#endif
+
+/**
+ * Keyframe levels. The LEDs are on plain GPIO (no compare output is free on
+ * PA0 or PA1) so indicators are either on or off.
+ */
+#define INDICATOR_LEVEL_OFF 0x00
+#define INDICATOR_LEVEL_ON 0xFF
+
+/**
+ * \struct IndicatorKeyframe
+ * One step of an animation: show level for frames * INDICATOR_FRAME_MILLIS.
+ * Animations are arrays of these kept in flash and ended by a stop or loop
+ * marker. Build them with the INDICATOR_KEY/STOP/LOOP/REPEAT macros. Steps
+ * only wake the CPU at their end.
+ */
+typedef struct _IndicatorKeyframeType
+{
+    uint8_t level;
+    uint8_t frames;
+} IndicatorKeyframe;
+
+#define INDICATOR_FRAMES_STOP 0x00
+#define INDICATOR_FRAMES_REPEAT 0xFE
+#define INDICATOR_FRAMES_LOOP 0xFF
+
+#define INDICATOR_MILLIS_TO_FRAMES(MILLIS) (uint8_t)(((MILLIS) + INDICATOR_FRAME_MILLIS - 1) / INDICATOR_FRAME_MILLIS)
+
+/**
+ * Show LEVEL for MILLIS (rounded up to whole frames, at most 253 of them).
+ */
+#define INDICATOR_KEY(LEVEL, MILLIS) { (LEVEL), INDICATOR_MILLIS_TO_FRAMES(MILLIS) }
+
+/**
+ * Show LEVEL and stop animating.
+ */
+#define INDICATOR_STOP(LEVEL) { (LEVEL), INDICATOR_FRAMES_STOP }
+
+/**
+ * Carry on from the keyframe at INDEX.
+ */
+#define INDICATOR_LOOP(INDEX) { (INDEX), INDICATOR_FRAMES_LOOP }
+
+/**
+ * Carry on from the keyframe at INDEX as many times as the repeats given to
+ * SetIndicatorModeWRepeats, then with the next keyframe. An animation has one
+ * repeat count so these can't be nested.
+ */
+#define INDICATOR_REPEAT(INDEX) { (INDEX), INDICATOR_FRAMES_REPEAT }
 
 struct _IndicatorType;
 
@@ -38,16 +101,32 @@ typedef struct _IndicatorType
     IndicatorMode _mode;
     IndicatorMode _modeStack[INDICATOR_MODE_STACK_SIZE];
     uint8_t _modeStackLen;
-    IndicatorState _state;
-    uint16_t _time;
-    uint8_t _phase;
+    IndicatorState _state;
+    const IndicatorKeyframe* _animation;
+    const IndicatorKeyframe* _keyframe;
+    uint8_t _repeatsLeft;
+    /**
+     * Until the current keyframe ends. Counted down by the shared frame
+     * timer.
+     */
+    uint16_t _millisLeft;
     OnIndicatorModeChangeFunc _onmodeChange;
     OnIndicatorStateChangeFunc _onstateChange;
-    RunLoopPort _port;
 } Indicator;
 
+/**
+ * \return The initialized indicator or 0 if INDICATOR_MAX_INDICATORS are
+ *         already animating.
+ */
+
 Indicator* IndicatorInit(Indicator* newIndicator, OnIndicatorModeChangeFunc onModeChange, OnIndicatorStateChangeFunc onStateChange);
 void SetIndicatorMode(Indicator* indicator, IndicatorMode mode);
+
+/**
+ * Set a mode whose animation has an INDICATOR_REPEAT marker, e.g.
+ * INDICATORMODE_CODE which blinks repeats + 1 times.
+ */
+void SetIndicatorModeWRepeats(Indicator* indicator, IndicatorMode mode, uint8_t repeats);
 void PushIndicatorMode(Indicator* indicator, IndicatorMode mode);
 IndicatorMode PopIndicatorMode(Indicator* indicator);
 
@@ -0,0 +1,136 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "PatternStore.h"
+#include <util/crc16.h>
+
+#define _SLOT_EMPTY 0xFF
+
+/**
+ * Bump whenever PatternStoreCell (including IRCode) changes so cells written
+ * by older firmware fail their check instead of loading as garbage.
+ */
+#define _LAYOUT_VERSION 2
+
+static PatternStoreCell EEMEM _journal[PATTERNSTORE_CELLS];
+
+/**
+ * Sequence numbers wrap so compare them by distance.
+ */
+static inline uint8_t _isNewer(uint16_t sequence, uint16_t than)
+{
+    return ((int16_t)(sequence - than) > 0);
+}
+
+static uint8_t _cellCheck(const PatternStoreCell* cell)
+{
+    const uint8_t* code = (const uint8_t*)&cell->code;
+    uint8_t crc = _crc8_ccitt_update(0, _LAYOUT_VERSION);
+    for (uint8_t i = 0; i < sizeof(IRCode); ++i)
+    {
+        crc = _crc8_ccitt_update(crc, code[i]);
+    }
+    crc = _crc8_ccitt_update(crc, cell->sequence & 0xFF);
+    crc = _crc8_ccitt_update(crc, cell->sequence >> 8);
+    return _crc8_ccitt_update(crc, cell->slot);
+}
+
+static uint8_t _isLive(PatternStore* store, uint8_t cell)
+{
+    for (uint8_t slot = 0; slot < PATTERNSTORE_SLOTS; ++slot)
+    {
+        if (store->_cells[slot] == cell)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+PatternStore* PatternStoreInit(PatternStore* store)
+{
+    if (store)
+    {
+        uint16_t slotSequences[PATTERNSTORE_SLOTS];
+        uint8_t isEmpty = 1;
+        memset(store->_cells, PATTERNSTORE_NO_CELL, sizeof(store->_cells));
+        store->_sequence = 0;
+        store->_nextCell = 0;
+
+        for (uint8_t cell = 0; cell < PATTERNSTORE_CELLS; ++cell)
+        {
+            PatternStoreCell entry;
+            eeprom_read_block(&entry, &_journal[cell], sizeof(entry));
+            const uint8_t slot = entry.slot;
+            if (slot >= PATTERNSTORE_SLOTS || entry.check != _cellCheck(&entry))
+            {
+                continue;
+            }
+            const uint16_t sequence = entry.sequence;
+            if (PATTERNSTORE_NO_CELL == store->_cells[slot] || _isNewer(sequence, slotSequences[slot]))
+            {
+                store->_cells[slot] = cell;
+                slotSequences[slot] = sequence;
+            }
+            if (isEmpty || _isNewer(sequence, store->_sequence))
+            {
+                // Pick the journal up after the newest cell.
+                store->_sequence = sequence;
+                store->_nextCell = (cell + 1) % PATTERNSTORE_CELLS;
+                isEmpty = 0;
+            }
+        }
+    }
+    return store;
+}
+
+uint8_t SavePattern(PatternStore* store, uint8_t slot, const IRCode* code)
+{
+    if (!store || slot >= PATTERNSTORE_SLOTS)
+    {
+        return 0;
+    }
+
+    // There are always more cells than slots so this finds a free one.
+    uint8_t cell = store->_nextCell;
+    while (_isLive(store, cell))
+    {
+        cell = (cell + 1) % PATTERNSTORE_CELLS;
+    }
+
+    PatternStoreCell written;
+    written.code = *code;
+    written.sequence = store->_sequence + 1;
+    written.slot = slot;
+    written.check = _cellCheck(&written);
+    PatternStoreCell* entry = &_journal[cell];
+    // Invalidate, fill and then commit the cell.
+    eeprom_update_byte(&entry->slot, _SLOT_EMPTY);
+    eeprom_update_block(code, &entry->code, sizeof(IRCode));
+    eeprom_update_word(&entry->sequence, written.sequence);
+    eeprom_update_byte(&entry->check, written.check);
+    eeprom_update_byte(&entry->slot, slot);
+
+    store->_cells[slot] = cell;
+    store->_sequence = written.sequence;
+    store->_nextCell = (cell + 1) % PATTERNSTORE_CELLS;
+    return 1;
+}
+
+uint8_t LoadPattern(PatternStore* store, uint8_t slot, IRCode* code)
+{
+    if (!HasPattern(store, slot))
+    {
+        return 0;
+    }
+    eeprom_read_block(code, &_journal[store->_cells[slot]].code, sizeof(IRCode));
+    return 1;
+}
+
+uint8_t HasPattern(PatternStore* store, uint8_t slot)
+{
+    return (store && slot < PATTERNSTORE_SLOTS && PATTERNSTORE_NO_CELL != store->_cells[slot]);
+}
@@ -0,0 +1,90 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file PatternStore.h
+ * Keeps decoded IR codes in EEPROM across power downs. The EEPROM is used as
+ * a circular journal of fixed size cells: every save goes to the next cell
+ * that doesn't hold a live code so writes are spread evenly over the whole
+ * EEPROM. A newer cell for a slot supersedes older ones. The journal is read
+ * once at startup to build a slot to cell index in RAM. Cells that fail their
+ * check (torn writes or a layout from another firmware) are ignored.
+ */
+
+#ifndef PATTERNSTORE_H_
+#define PATTERNSTORE_H_
+
+#include "Framework.h"
+#include "IRProtocol.h"
+#include <avr/eeprom.h>
+
+/**
+ * Number of codes that can be stored.
+ */
+#ifndef PATTERNSTORE_SLOTS
+#define PATTERNSTORE_SLOTS 8
+#endif
+
+/**
+ * \struct PatternStoreCell
+ * One journal entry as laid out in EEPROM. The slot is written last so a
+ * cell interrupted by a power loss is never mistaken for a valid one.
+ */
+typedef struct _PatternStoreCellType
+{
+    IRCode code;
+    uint16_t sequence;
+    /**
+     * CRC-8 of the layout version and the other fields.
+     */
+    uint8_t check;
+    uint8_t slot;
+} PatternStoreCell;
+
+#define PATTERNSTORE_CELLS ((E2END + 1) / sizeof(PatternStoreCell))
+#define PATTERNSTORE_NO_CELL 0xFF
+
+/**
+ * \struct PatternStore
+ */
+typedef struct _PatternStoreType
+{
+    uint8_t _cells[PATTERNSTORE_SLOTS];
+    uint16_t _sequence;
+    uint8_t _nextCell;
+} PatternStore;
+
+/**
+ * Objective-C style pattern store initializer. Reads the journal headers to
+ * build the index.
+ * \param  store    The store to initialize.
+ * \return A pointer to the initialized store.
+ */
+PatternStore* PatternStoreInit(PatternStore* store);
+
+/**
+ * Write a code to EEPROM. Blocks until the write completes (about 30ms).
+ * \param  store    The store to save to.
+ * \param  slot     The slot to save into. Replaces any code already there.
+ * \param  code     The code to save.
+ * \return 1 if the code was saved.
+ */
+uint8_t SavePattern(PatternStore* store, uint8_t slot, const IRCode* code);
+
+/**
+ * Read a code from EEPROM.
+ * \param  store    The store to read from.
+ * \param  slot     The slot to read.
+ * \param  code     Populated with the code if the slot holds one.
+ * \return 1 if the slot holds a code.
+ */
+uint8_t LoadPattern(PatternStore* store, uint8_t slot, IRCode* code);
+
+/**
+ * \return 1 if the slot holds a code.
+ */
+uint8_t HasPattern(PatternStore* store, uint8_t slot);
+
+#endif /* PATTERNSTORE_H_ */
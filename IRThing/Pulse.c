@@ -0,0 +1,97 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "Pulse.h"
+
+static uint16_t _tolerance(uint16_t units)
+{
+    const uint16_t tolerance = units >> PULSETRAIN_TOLERANCE_SHIFT;
+    return (tolerance < PULSETRAIN_MIN_TOLERANCE) ? PULSETRAIN_MIN_TOLERANCE : tolerance;
+}
+
+static uint8_t _findSymbol(PulseTrain* train, uint16_t units)
+{
+    const uint16_t tolerance = _tolerance(units);
+
+    // Closest match wins so neighbouring symbols can't steal each other's edges.
+    uint8_t best = PULSETRAIN_MAX_SYMBOLS;
+    uint16_t bestError = tolerance + 1;
+    for (uint8_t i = 0; i < train->symbolCount; ++i)
+    {
+        const uint16_t symbol = train->symbols[i];
+        const uint16_t error = (symbol > units) ? symbol - units : units - symbol;
+        if (error < bestError)
+        {
+            best = i;
+            bestError = error;
+        }
+    }
+
+    if (PULSETRAIN_MAX_SYMBOLS == best && train->symbolCount < PULSETRAIN_MAX_SYMBOLS)
+    {
+        best = train->symbolCount++;
+        train->symbols[best] = units;
+    }
+    return best;
+}
+
+PulseTrain* PulseTrainInit(PulseTrain* train)
+{
+    if (train)
+    {
+        train->edgeCount = 0;
+        train->symbolCount = 0;
+    }
+    return train;
+}
+
+uint8_t AppendPulseTrainEdge(PulseTrain* train, uint16_t units)
+{
+    const uint16_t index = train->edgeCount;
+    if (index >= PULSETRAIN_MAX_EDGES)
+    {
+        return PULSETRAIN_FULL;
+    }
+
+    const uint8_t symbol = _findSymbol(train, units);
+    if (PULSETRAIN_MAX_SYMBOLS == symbol)
+    {
+        return PULSETRAIN_NO_SYMBOLS;
+    }
+
+    uint8_t* packed = &train->edges[index >> 1];
+    if (index & 1)
+    {
+        *packed = (*packed & 0x0F) | (symbol << 4);
+    }
+    else
+    {
+        *packed = symbol;
+    }
+    train->edgeCount = index + 1;
+    return PULSETRAIN_OK;
+}
+
+uint16_t GetPulseTrainEdge(const PulseTrain* train, uint16_t index)
+{
+    if (index >= train->edgeCount)
+    {
+        return 0;
+    }
+    const uint8_t packed = train->edges[index >> 1];
+    return train->symbols[(index & 1) ? (packed >> 4) : (packed & 0x0F)];
+}
+
+uint8_t IsPulseTrainEdgeMatch(const PulseTrain* train, uint16_t index, uint16_t units)
+{
+    const uint16_t symbol = GetPulseTrainEdge(train, index);
+    if (!symbol)
+    {
+        return 0;
+    }
+    const uint16_t error = (symbol > units) ? symbol - units : units - symbol;
+    return (error <= _tolerance(units));
+}
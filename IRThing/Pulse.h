@@ -1,31 +1,107 @@
-/*
-~          +-+
-~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
-~          +-+
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
 */
 
 #ifndef PULSE_H_
 #define PULSE_H_
 
+#include <stdint.h>
+
+/**
+ * Duration of one pulse unit in microseconds.
+ */
+#define PULSE_RESOLUTION_MICROS 20
+
+/**
+ * Maximum number of distinct durations in one pulse train. Symbol indices are
+ * stored as nibbles so this can't be more than 16.
+ */
+#define PULSETRAIN_MAX_SYMBOLS 16
+
+/**
+ * Maximum number of marks and spaces in one pulse train. Must be even.
+ */
+#ifndef PULSETRAIN_MAX_EDGES
+#define PULSETRAIN_MAX_EDGES 400
+#endif
+
+/**
+ * Durations within 1/2^PULSETRAIN_TOLERANCE_SHIFT of a symbol (but never less
+ * than PULSETRAIN_MIN_TOLERANCE units) are quantized to that symbol.
+ */
+#define PULSETRAIN_TOLERANCE_SHIFT 2
+#define PULSETRAIN_MIN_TOLERANCE 4
+
+// +--------------------------------------------------------------------------+
+// | APPEND RESULTS
+// +--------------------------------------------------------------------------+
+#define PULSETRAIN_OK         0
+#define PULSETRAIN_FULL       1
+#define PULSETRAIN_NO_SYMBOLS 2
+
 /**
- * \struct Pulse
- * Type that contains timings for high and low pulse emitted by an IR remote.
+ * \struct PulseTrain
+ * Alternating marks and spaces emitted by an IR remote, starting with a mark.
+ * Most protocols only use a handful of distinct durations so each edge is
+ * stored as a 4-bit index into a per-train dictionary of durations.
  */
-typedef struct _PulseType
+typedef struct _PulseTrainType
 {
     /**
-     * High pulse. Interpretation will vary by encoding. Read docs in the
-     * method populating this data to understand how to interpret it.
+     * Distinct durations in PULSE_RESOLUTION_MICROS units.
      */
-    uint8_t high;
-    
+    uint16_t symbols[PULSETRAIN_MAX_SYMBOLS];
+
     /**
-     * Low pulse. Interpretation will vary by encoding. Read docs in the
-     * method populating this data to understand how to interpret it.
+     * Symbol indices. Even edges (marks) in the low nibble, odd edges
+     * (spaces) in the high nibble.
      */
-    uint8_t low;
+    uint8_t edges[PULSETRAIN_MAX_EDGES / 2];
+
+    uint16_t edgeCount;
+    uint8_t symbolCount;
+} PulseTrain;
+
+/**
+ * Objective-C style pulse train initializer. Empties the train.
+ * \param  train   The pulse train to initialize.
+ * \return A pointer to the initialized pulse train.
+ */
+PulseTrain* PulseTrainInit(PulseTrain* train);
+
+/**
+ * Quantize a duration and append it to the train.
+ * \param  train   The pulse train to append to.
+ * \param  units   Duration of the mark or space in PULSE_RESOLUTION_MICROS units.
+ * \return PULSETRAIN_OK, PULSETRAIN_FULL if there is no room for another edge
+ *         or PULSETRAIN_NO_SYMBOLS if the duration doesn't match any symbol
+ *         and the dictionary is full.
+ */
+uint8_t AppendPulseTrainEdge(PulseTrain* train, uint16_t units);
 
-} Pulse;
+/**
+ * \param  train   The pulse train to read from.
+ * \param  index   Edge index. Even indices are marks and odd are spaces.
+ * \return The quantized duration in PULSE_RESOLUTION_MICROS units or 0 if
+ *         index is past the end of the train.
+ */
+uint16_t GetPulseTrainEdge(const PulseTrain* train, uint16_t index);
 
+/**
+ * Compare a duration with an edge already in the train without appending it.
+ * \param  train   The pulse train to compare with.
+ * \param  index   Edge index. Even indices are marks and odd are spaces.
+ * \param  units   Duration in PULSE_RESOLUTION_MICROS units.
+ * \return 1 if the duration is within tolerance of the edge, 0 if it isn't
+ *         or index is past the end of the train.
+ */
+uint8_t IsPulseTrainEdgeMatch(const PulseTrain* train, uint16_t index, uint16_t units);
+
+static inline uint32_t PulseUnitsToMicros(uint16_t units)
+{
+    return (uint32_t)units * PULSE_RESOLUTION_MICROS;
+}
 
-#endif /* PULSE_H_ */
\ No newline at end of file
+#endif /* PULSE_H_ */
@@ -5,19 +5,15 @@
 */
 
 #include "Framework.h"
-#include "tinker/Button.h"
+#include "tinker/ButtonGroup.h"
+#include "tinker/Gesture.h"
 #include "tinker/State.h"
 #include "states/AllStates.h"
 #include "tinker/Machine.h"
 #include "Indicator.h"
+#include "PatternStore.h"
 
 
-// +--------------------------------------------------------------------------+
-// | MAIN RUN LOOP
-// +--------------------------------------------------------------------------+
-
-void ensureMainRunLoopTimer();
-
 // +--------------------------------------------------------------------------+
 // | STATES
 // +--------------------------------------------------------------------------+
@@ -30,28 +26,93 @@ typedef struct _DeviceStateT
 
 static DeviceState PRDS;
 
-State RootState;
-State RunningState;
-State VisualizeState;
-State CapturingState;
-State RepeatingState;
+static StateErrorType OnRootClick(State* state, StateEventType event);
+static StateErrorType OnRootLongPress(State* state, StateEventType event);
+static StateErrorType OnRootDoubleClick(State* state, StateEventType event);
+
+static const StateEventFunc rootEvents[] TINKER_PROGMEM = {
+    [EVENT_BUTTON_CLICK] = OnRootClick,
+    [EVENT_BUTTON_LONG_PRESS] = OnRootLongPress,
+    [EVENT_BUTTON_DOUBLE_CLICK] = OnRootDoubleClick,
+};
+
+// The rest of the hierarchy is declared by the modules in states/.
+TINKER_STATE(RootState, 0, 0, 0, 0, TINKER_EVENTS(rootEvents), TINKER_ANY_POWER, 0);
+
+static State* const allStates[] = { &RootState, &RunningState, &VisualizeState, &CapturingState, &RepeatingState };
 
 // Optimization. Same as GetMachineFocus(&masterMachine);
 State* focusedState;
 
 Machine masterMachine;
 
+// +--------------------------------------------------------------------------+
+// | PATTERNS
+// +--------------------------------------------------------------------------+
+#define PATTERN_SLOT 0
+
+static PatternStore patternStore;
+static Pattern storedPattern;
+
 void Shutdown()
 {
-    SetMachineState(&masterMachine, &RootState);
+    RequestMachineState(&masterMachine, &RootState);
 }
 
 // +--------------------------------------------------------------------------+
 // | BUTTON
 // +--------------------------------------------------------------------------+
-static Button powerButton;
+#define POWER_BUTTON_HOLD_MILLIS 1500
+
+static ButtonGroup buttonGroup;
+static Gesture powerButtonGesture;
+static Timer buttonSampleTimer;
+static uint8_t buttonQuietSamples;
+
+/**
+ * Samples in a row with nothing left to debounce before sampling stops.
+ */
+#define BUTTON_QUIET_SAMPLES 8
 static Indicator powerButtonIndicator;
 
+/**
+ * Shows codes (e.g. why a capture failed) on PINA_VISUAL. Holds the pin while
+ * it animates.
+ */
+static Indicator visualIndicator;
+volatile uint8_t visualPinIsHeld;
+
+void onVisualIndicatorStateChange(Indicator* indicator, IndicatorState state)
+{
+    switch(state)
+    {
+        case INDICATORSTATE_OFF:
+        {
+            SETPIN_LOW(A, 1);
+        }
+        break;
+        case INDICATORSTATE_ON:
+        {
+            SETPIN_HIGH(A, 1);
+        }
+        break;
+        case INDICATORSTATE_STOPPED:
+        {
+            visualPinIsHeld = 0;
+        }
+        break;
+    }
+}
+
+static void showVisualCode(uint8_t code)
+{
+    if (code)
+    {
+        visualPinIsHeld = 1;
+        SetIndicatorModeWRepeats(&visualIndicator, INDICATORMODE_CODE, code - 1);
+    }
+}
+
 void onIndicatorStateChange(Indicator* indicator, IndicatorState state)
 {
     switch(state)
@@ -59,56 +120,125 @@ void onIndicatorStateChange(Indicator* indicator, IndicatorState state)
         case INDICATORSTATE_OFF:
         {
             SETPIN_LOW(A, 0);
-            ensureMainRunLoopTimer();
         }
         break;
         case INDICATORSTATE_ON:
         {
             SETPIN_HIGH(A, 0);
-            ensureMainRunLoopTimer();
         }
         break;
     }
 }
 
-void OnButtonEvent(Button* target, ButtonEventType event)
+void OnPowerButtonGesture(Gesture* gesture, GestureEventType event, uint8_t count)
 {
     switch(event) {
-        case BUTTON_EVENT_UP:
+        case GESTURE_EVENT_CLICKS_DONE:
         {
-            PopIndicatorMode(&powerButtonIndicator);
-            if (PRDS.wasLongPress && !focusedState)
+            // Wait for the clicks to finish so the first half of a double
+            // click doesn't run the single click action.
+            if (1 == count)
             {
-                SetIndicatorMode(&powerButtonIndicator, INDICATORMODE_BLINK_OFF);
+                DispatchMachineEvent(&masterMachine, EVENT_BUTTON_CLICK);
             }
-            else if (!focusedState)
+            else if (2 == count)
             {
-                SetMachineState(&masterMachine, &VisualizeState);
+                DispatchMachineEvent(&masterMachine, EVENT_BUTTON_DOUBLE_CLICK);
             }
-            else if (focusedState == &VisualizeState)
-            {
-                SetMachineState(&masterMachine, &CapturingState);
-            }
-            else
+        }
+        break;
+        case GESTURE_EVENT_HOLD:
+        {
+            PRDS.wasLongPress = 1;
+            DispatchMachineEvent(&masterMachine, EVENT_BUTTON_LONG_PRESS);
+        }
+        break;
+    }
+}
+
+void OnButtonEvent(ButtonGroup* target, ButtonEventType event, uint8_t buttons)
+{
+    switch(event) {
+        case BUTTON_EVENT_UP:
+        {
+            PopIndicatorMode(&powerButtonIndicator);
+            if (PRDS.wasLongPress)
             {
-                StateHandleInterrupt(focusedState, STATE_INT_BUTTON_CLICK);
+                // The long press already shut us down.
+                SetIndicatorMode(&powerButtonIndicator, INDICATORMODE_BLINK_OFF);
             }
-            PRDS.isInterrupted = 0;
-            ENABLE_EXTERNAL_INTERRUPT(0);
+            GestureHandleButtonEvent(&powerButtonGesture, event);
         }
         break;
         case BUTTON_EVENT_DOWN:
         {
             PushIndicatorMode(&powerButtonIndicator, INDICATORMODE_ON);
             PRDS.wasLongPress = 0;
+            GestureHandleButtonEvent(&powerButtonGesture, event);
         }
         break;
-        case BUTTON_EVENT_LONG_PRESS:
+    }
+}
+
+/**
+ * Stop sampling and sleep until the button changes again. Pressing is seen by
+ * INT0 (low level, the only sense that wakes from power down) and releasing
+ * by PCINT10. Holds are timed by the gesture's one-shot timer instead of
+ * samples so a held button wakes the CPU once rather than every millisecond.
+ * That timer needs Timer0 so the governor still only idles until the hold
+ * is decided (POWER_BUTTON_HOLD_MILLIS); after that it can power down.
+ */
+static void waitForButtonEdge()
+{
+    CancelTimer(&mainTimerService, &buttonSampleTimer);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        PRDS.isInterrupted = 0;
+        if (!GetButtonGroupPressed(&buttonGroup))
         {
-            PRDS.wasLongPress = 1;
-            Shutdown();
+            ENABLE_EXTERNAL_INTERRUPT(0);
         }
-        break;
+        else if (IS_PIN_HIGH(B, 2))
+        {
+            // Let go while we were settling. Go again.
+            PRDS.isInterrupted = 1;
+        }
+        else
+        {
+            CLEAR_INTERRUPT_FLAGS(GIFR, _BV(PCIF1));
+            PCMSK1 |= _BV(PCINT10);
+            GIMSK |= _BV(PCIE1);
+        }
+    }
+}
+
+void OnButtonSample(Timer* timer)
+{
+    // Already in the runloop. Posting from here would race the ISRs that
+    // post to it.
+    ButtonGroupSample(&buttonGroup, PINB);
+    // End the burst once the debounced state has agreed with the pin for a
+    // while.
+    if (!IsButtonGroupSettled(&buttonGroup))
+    {
+        buttonQuietSamples = 0;
+    }
+    else if (++buttonQuietSamples >= BUTTON_QUIET_SAMPLES)
+    {
+        waitForButtonEdge();
+    }
+}
+
+/**
+ * Sample the button in a short burst once an edge interrupt has seen it
+ * change.
+ */
+static inline void ensureButtonSampling()
+{
+    if (PRDS.isInterrupted && !IsTimerScheduled(&buttonSampleTimer))
+    {
+        buttonQuietSamples = 0;
+        ScheduleTimer(&mainTimerService, &buttonSampleTimer, 1, 1);
     }
 }
 
@@ -116,7 +246,15 @@ ISR(INT0_vect)
 {
     DISABLE_EXTERNAL_INTERRUPT(0);
     PRDS.isInterrupted = 1;
-    ensureMainRunLoopTimer();
+    PostRunLoopMessage(&mainRunLoop, RUNLOOP_MESSAGE_BUTTONGROUPSAMPLE, PINB);
+}
+
+ISR(PCINT1_vect)
+{
+    GIMSK &= ~_BV(PCIE1);
+    PCMSK1 &= ~_BV(PCINT10);
+    PRDS.isInterrupted = 1;
+    PostRunLoopMessage(&mainRunLoop, RUNLOOP_MESSAGE_BUTTONGROUPSAMPLE, PINB);
 }
 
 
@@ -124,21 +262,140 @@ ISR(INT0_vect)
 // | STATE HANDLERS
 // +--------------------------------------------------------------------------+
 
-void OnCapturePattern(State* captureState, Pulse* pulses, uint8_t pulseCount)
+static StateErrorType OnRootClick(State* state, StateEventType event)
 {
-    SetMachineStateWData(&masterMachine, &RepeatingState, pulses, pulseCount);
+    RequestMachineState(&masterMachine, &VisualizeState);
+    return STATE_ERROR_NONE;
 }
 
-void OnCapturePatternFailed(State* captureState)
+static StateErrorType OnRootLongPress(State* state, StateEventType event)
 {
-    //SetMachineState(&masterMachine, &VisualizeState);
+    Shutdown();
+    return STATE_ERROR_NONE;
+}
+
+/**
+ * Fire the saved pattern from anywhere without capturing it again.
+ */
+static StateErrorType OnRootDoubleClick(State* state, StateEventType event)
+{
+    if (LoadPattern(&patternStore, PATTERN_SLOT, &storedPattern.code))
+    {
+        storedPattern.train = 0;
+        storedPattern.trainRepeat = 0;
+        storedPattern.playOnEntry = 1;
+        RequestMachineStateWData(&masterMachine, &RepeatingState, &storedPattern, sizeof(Pattern));
+    }
+    return STATE_ERROR_NONE;
+}
+
+StateErrorType OnVisualizeClick(State* visualizeState, StateEventType event)
+{
+    RequestMachineState(&masterMachine, &CapturingState);
+    return STATE_ERROR_NONE;
+}
+
+StateErrorType OnCaptureClick(State* captureState, StateEventType event)
+{
+    if (LoadPattern(&patternStore, PATTERN_SLOT, &storedPattern.code))
+    {
+        // Click again instead of capturing to repeat the saved code.
+        storedPattern.train = 0;
+        storedPattern.playOnEntry = 0;
+        RequestMachineStateWData(&masterMachine, &RepeatingState, &storedPattern, sizeof(Pattern));
+    }
+    // Swallow the click either way. It shouldn't restart the session.
+    return STATE_ERROR_NONE;
+}
+
+void OnCapturePattern(State* captureState, Pattern* pattern)
+{
+    if (IRPROTOCOL_UNKNOWN != pattern->code.protocol)
+    {
+        SavePattern(&patternStore, PATTERN_SLOT, &pattern->code);
+    }
+    // Called from the capture loop. Leave now, before capturing starts over
+    // on top of the pattern.
+    SetMachineStateWData(&masterMachine, &RepeatingState, pattern, sizeof(Pattern));
+}
+
+void OnCapturePatternFailed(State* captureState, uint8_t failureCode)
+{
+    // Capturing carries on underneath. Edges aren't mirrored until it's shown.
+    showVisualCode(failureCode);
+}
+
+// +--------------------------------------------------------------------------+
+// | POWER GOVERNOR
+// +--------------------------------------------------------------------------+
+/**
+ * Gate the clocks of the peripherals no entered state needs. Drivers turn on
+ * the ones they use when they start (see IRCapture and IRPlayback) so this
+ * only ever turns clocks off.
+ */
+static void governPeripherals(Machine* machine)
+{
+    PRR |= POWER_PERIPHERALS_ALL & ~GetMachinePower(machine).peripherals;
+}
+
+void sleepUntilInterrupt()
+{
+    if (!HasRunLoopMessages(&mainRunLoop) && !HasPendingMachineTransitions(&masterMachine))
+    {
+        const StatePower power = GetMachinePower(&masterMachine);
+        uint8_t sleep = power.deepestSleep;
+        if (power.peripherals & POWER_PERIPHERAL_FULL_CLOCK)
+        {
+            setSystemClock(CLOCK_DIVISION_FULL);
+        }
+        else if (PRR & _BV(PRTIM1))
+        {
+            // Nothing is being timed by Timer1 so nothing needs the full clock.
+            setSystemClock(CLOCK_DIVISION_SLOW);
+        }
+        // Timer0 (so every scheduled timer, including button sampling) and a
+        // running Timer1 only work in idle.
+        if (sleep > POWER_SLEEP_IDLE && (PRDS.isInterrupted || HasScheduledTimers(&mainTimerService) || !(PRR & _BV(PRTIM1))))
+        {
+            sleep = POWER_SLEEP_IDLE;
+        }
+        if (sleep >= POWER_SLEEP_POWER_DOWN)
+        {
+            set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+            sleep_enable();
+            sleep_bod_disable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+        else if (sleep == POWER_SLEEP_IDLE)
+        {
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+    }
+    sei();
 }
 
 void OnStateChange(Machine* machine, State* oldState, State* newState)
 {
     focusedState = IsRootState(newState) ? 0 : newState;
+    governPeripherals(machine);
+
+    if (oldState == &CapturingState && visualPinIsHeld)
+    {
+        // Any failure code is stale now and the next state may want the pin.
+        SetIndicatorMode(&visualIndicator, INDICATORMODE_OFF);
+    }
     
-    if (!oldState || IsRootState(oldState))
+    if (IsRootState(newState))
+    {
+        // Powered down or just booted. The button release sets the indicator.
+    }
+    else if (!oldState || IsRootState(oldState))
     {
         SetIndicatorMode(&powerButtonIndicator, INDICATORMODE_BLINK_ON);
     }
@@ -160,70 +417,178 @@ void OnStateChange(Machine* machine, State* oldState, State* newState)
 // +--------------------------------------------------------------------------+
 // | RUN LOOP
 // +--------------------------------------------------------------------------+
-#define _MAIN_RUNLOOP_TIMER_ENABLED 0x1
-#define _MAIN_RUNLOOP_TIMER_ACTIVE 0x2
-
-static const uint8_t timerPeriodMillis = 1;
+// Timer0 runs at F_CPU/1024 (~51us per count, ~13ms per overflow) and only
+// while a timer is scheduled. Counts are extended to 32 bits in software.
+// While the system clock is divided the prescaler is divided by as much (see
+// setSystemClock) so counts always take the same time.
+#define _MAIN_TIMER_PRESCALE 1024UL
+#define _MAIN_TIMER_CLOCK_SELECT (_BV(CS02) | _BV(CS00))
+#define _MAIN_TIMER_CYCLES_PER_MILLI (F_CPU / 1000UL)
 
 RunLoop mainRunLoop;
-
-static uint16_t elapsedLoopDriveTimeMillis;
-static uint8_t runloopTimerState;
-
-void ensureMainRunLoopTimer()
+TimerService mainTimerService;
+
+static volatile uint32_t mainTimerHigh;
+static uint32_t mainTimerAlarmAt;
+static uint8_t mainTimerIsArmed;
+static uint32_t mainTimerLastCount;
+static uint16_t mainTimerRemainderCycles;
+static uint8_t mainTimerClockSelect;
+static uint8_t systemClockDivision;
+
+/**
+ * Must be called with interrupts disabled.
+ */
+static uint32_t mainTimerNow()
 {
-    // Try to drive the runloop from timer1. If interrupts are disabled then someone
-    // will need to call driveMainRunLoop manually.
-    // 20MHz / 64 = 312kHz / 255 = ~123 overflows per second or ~.81msec per overflow
-    runloopTimerState |= _MAIN_RUNLOOP_TIMER_ACTIVE;
-    if (runloopTimerState & _MAIN_RUNLOOP_TIMER_ENABLED)
-    {
-        TCCR0B = _BV(CS01) | _BV(CS00);
-    }
+    const uint8_t count = TCNT0;
+    uint32_t high = mainTimerHigh;
+    if ((TIFR0 & _BV(TOV0)) && count < 0x80)
+    {
+        // Overflowed but the ISR hasn't run yet.
+        high += 0x100;
+    }
+    return high | count;
 }
 
-void driveMainRunLoop(uint8_t timeSinceLastRunMillis)
+/**
+ * Raise the alarm if the deadline has passed, otherwise set up the compare
+ * unit if the deadline falls within the current overflow period. Must be
+ * called with interrupts disabled.
+ * \return 1 if the deadline has passed.
+ */
+static uint8_t mainTimerCheckAlarm()
 {
-    if (PRDS.isInterrupted)
+    if (!mainTimerIsArmed)
     {
-        mainRunLoop.runMode(&mainRunLoop, RUNLOOP_MESSAGE_BUTTONTEST, IS_PIN_HIGH(B, 2));
+        return 0;
     }
-    else if (INDICATORSTATE_STOPPED == GetIndicatorState(&powerButtonIndicator))
+    const uint32_t now = mainTimerNow();
+    if ((int32_t)(mainTimerAlarmAt - now) <= 0)
     {
-        elapsedLoopDriveTimeMillis = 0;
-        runloopTimerState &= ~_MAIN_RUNLOOP_TIMER_ACTIVE;
-        TCCR0B = 0;
+        TIMSK0 &= ~_BV(OCIE0A);
+        mainTimerIsArmed = 0;
+        return 1;
     }
-    else if (elapsedLoopDriveTimeMillis >= 16)
+    if ((mainTimerAlarmAt ^ now) < 0x100)
     {
-        mainRunLoop.runMode(&mainRunLoop, RUNLOOP_MESSAGE_FRAME, (RunLoopMessageData)elapsedLoopDriveTimeMillis);
-        elapsedLoopDriveTimeMillis = 0;
+        OCR0A = mainTimerAlarmAt & 0xFF;
+        CLEAR_INTERRUPT_FLAGS(TIFR0, _BV(OCF0A));
+        TIMSK0 |= _BV(OCIE0A);
     }
-    else
+    return 0;
+}
+
+static uint16_t mainTimerElapsed()
+{
+    uint32_t millis;
+    // armMainTimer reads these from the alarm interrupt too (see
+    // TimerServiceAlarm) so update them together.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        elapsedLoopDriveTimeMillis += timeSinceLastRunMillis;
+        const uint32_t count = mainTimerNow();
+        // Carry the part of a millisecond that didn't make it into the result.
+        const uint32_t cycles = (count - mainTimerLastCount) * _MAIN_TIMER_PRESCALE + mainTimerRemainderCycles;
+        mainTimerLastCount = count;
+        millis = cycles / _MAIN_TIMER_CYCLES_PER_MILLI;
+        mainTimerRemainderCycles = cycles - (millis * _MAIN_TIMER_CYCLES_PER_MILLI);
     }
-    
+    return (millis > 0xFFFF) ? 0xFFFF : millis;
 }
 
-void disableMainLoopTimer()
+static void armMainTimer(uint16_t millis)
 {
-    runloopTimerState &= ~_MAIN_RUNLOOP_TIMER_ENABLED;
-    TCCR0B = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (0 == millis)
+        {
+            TIMSK0 &= ~_BV(OCIE0A);
+            TCCR0B = 0;
+            mainTimerIsArmed = 0;
+        }
+        else
+        {
+            const uint32_t cycles = (uint32_t)millis * _MAIN_TIMER_CYCLES_PER_MILLI - mainTimerRemainderCycles;
+            mainTimerAlarmAt = mainTimerLastCount + (cycles + _MAIN_TIMER_PRESCALE - 1) / _MAIN_TIMER_PRESCALE;
+            const uint32_t soonest = mainTimerNow() + 2;
+            if ((int32_t)(mainTimerAlarmAt - soonest) < 0)
+            {
+                // Already late (the runloop was busy). Alarm from the ISR
+                // rather than posting from here.
+                mainTimerAlarmAt = soonest;
+            }
+            TCCR0B = mainTimerClockSelect;
+            mainTimerIsArmed = 1;
+            mainTimerCheckAlarm();
+        }
+    }
 }
 
-void enableMainLoopTimer()
+// +--------------------------------------------------------------------------+
+// | CLOCK
+// +--------------------------------------------------------------------------+
+/**
+ * \return The Timer0 clock select that counts at F_CPU / 1024 with the system
+ *         clock divided by division, or 0 if there isn't one.
+ */
+static uint8_t mainTimerClockSelectFor(uint8_t division)
 {
-    runloopTimerState |= _MAIN_RUNLOOP_TIMER_ENABLED;
-    ensureMainRunLoopTimer();
+    switch(division)
+    {
+        case clock_div_1:
+            return _MAIN_TIMER_CLOCK_SELECT;    // clk/1024
+        case clock_div_4:
+            return _BV(CS02);                   // clk/256
+        case clock_div_16:
+            return _BV(CS01) | _BV(CS00);       // clk/64
+        case clock_div_128:
+            return _BV(CS01);                   // clk/8
+    }
+    return 0;
 }
 
+void setSystemClock(uint8_t division)
+{
+    const uint8_t clockSelect = mainTimerClockSelectFor(division);
+    if (division != systemClockDivision && clockSelect)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            // The Timer0 prescaler isn't reset so a switch costs at most one
+            // count (~51us) of drift.
+            clock_prescale_set((clock_div_t)division);
+            systemClockDivision = division;
+            mainTimerClockSelect = clockSelect;
+            if (TCCR0B)
+            {
+                TCCR0B = clockSelect;
+            }
+        }
+    }
+}
+
+uint32_t getSystemClockHz()
+{
+    return F_CPU >> systemClockDivision;
+}
 
 ISR(TIM0_OVF_vect)
 {
-    driveMainRunLoop(timerPeriodMillis);
+    mainTimerHigh += 0x100;
+    // If the compare unit is armed it will take care of the alarm.
+    if (!(TIMSK0 & _BV(OCIE0A)) && mainTimerCheckAlarm())
+    {
+        TimerServiceAlarm(&mainTimerService);
+    }
 }
 
+ISR(TIM0_COMPA_vect)
+{
+    if (mainTimerCheckAlarm())
+    {
+        TimerServiceAlarm(&mainTimerService);
+    }
+}
 
 // +--------------------------------------------------------------------------+
 // | MAIN!
@@ -233,43 +598,54 @@ static inline void init()
     cli();
     focusedState = 0;
     memset(&PRDS, 0, sizeof(PRDS));
-    elapsedLoopDriveTimeMillis = 0;
-    runloopTimerState = 0x3;
+    visualPinIsHeld = 0;
+    mainTimerHigh = 0;
+    mainTimerLastCount = 0;
+    mainTimerRemainderCycles = 0;
+    mainTimerIsArmed = 0;
+    // The CKDIV8 fuse may have left the clock divided.
+    clock_prescale_set(CLOCK_DIVISION_FULL);
+    systemClockDivision = CLOCK_DIVISION_FULL;
+    mainTimerClockSelect = _MAIN_TIMER_CLOCK_SELECT;
     
+    PatternStoreInit(&patternStore);
     InitRunLoop(&mainRunLoop);
+    TimerServiceInit(&mainTimerService, &mainRunLoop, mainTimerElapsed, armMainTimer);
     IndicatorInit(&powerButtonIndicator, 0, onIndicatorStateChange);
-    ButtonInit(&powerButton, OnButtonEvent, &mainRunLoop);
-    // TODO: if !ButtonInit then goto firmware error blink
-    
-    InitRepeatState(&RepeatingState, &RunningState);
-    InitCaptureState(&CapturingState, &RunningState, OnCapturePattern, OnCapturePatternFailed);
-    InitVisualizeState(&VisualizeState, &RunningState);
-    InitRunningState(&RunningState, &RootState, (State*[]){&VisualizeState, &CapturingState, &RepeatingState}, 3);
-    StateInitWSubstates(&RootState, 0, 0, 0, 0, (State*[]){&RunningState}, 0);
+    IndicatorInit(&visualIndicator, 0, onVisualIndicatorStateChange);
+    ButtonGroupInit(&buttonGroup, _BV(PINB_RUNBUTT), _BV(PINB_RUNBUTT), OnButtonEvent, &mainRunLoop);
+    // One button does everything so holding can't also repeat.
+    GestureInit(&powerButtonGesture, OnPowerButtonGesture, &mainTimerService, POWER_BUTTON_HOLD_MILLIS, 0);
+    TimerInit(&buttonSampleTimer, OnButtonSample);
+    // TODO: if !ButtonGroupInit then goto firmware error blink
     
-    MachineInit(&masterMachine, OnStateChange);
+    MachineInit(&masterMachine, OnStateChange, allStates, sizeof(allStates) / sizeof(allStates[0]));
 
     // +---[POWER SETTINGS]---------------------------------------------------+
     ACSR = 0;                               /**< Disable analog comparator. */
     /* Enable pullup resistors, enable INT0 when pulled low. */
     MCUCR &= ~((1<<PUD) | (1<<ISC01) | (1<<ISC00));    /**< INT0 low level */
-    PRR = _BV(PRADC) | _BV(PRTIM1);
+    PRR = POWER_PERIPHERALS_ALL;
     
     // +---[OTHER SETUP]------------------------------------------------------+
     PORTA = _BV(PINA_RUNNING) | _BV(PINA_VISUAL) | _BV(PINA_IR_IN);
     PORTB = _BV(PINB_RUNBUTT);
-    DDRA = _BV(PINA_RUNNING) | _BV(PINA_VISUAL) | _BV(PINA_IR_OUT) | _BV(PINA_PERIPH) | _BV(PINA4);
+    DDRA = _BV(PINA_RUNNING) | _BV(PINA_VISUAL) | _BV(PINA_IR_OUT) | _BV(PINA_PERIPH) | _BV(PINA4) | _BV(PINA_IR_CARRIER);
     ENABLE_EXTERNAL_INTERRUPT(0);
     
-    TCCR0A = 0;
+    // Normal mode. Stopped until a timer is scheduled.
+    TCCR0A = 0;
     TCCR0B = 0;
-    TIMSK0 |= _BV(TOIE0);
+    TCNT0 = 0;
+    TIMSK0 = _BV(TOIE0);
     
     // +----------------------------------------------------------------------+
     //  Blink all the indicators for half a second and let peripherals settle.
     _delay_ms(500);
     
     PORTA &= ~(_BV(PINA_VISUAL) | _BV(PINA_RUNNING));
+    // Start at the root so there is always a focus to dispatch events to.
+    SetMachineState(&masterMachine, &RootState);
     sei();
 }
 
@@ -279,26 +655,27 @@ int main(void)
 
     while(1)
     {
+        DrainRunLoop(&mainRunLoop);
+        // Event handlers only queue transitions. Run them here, outside of
+        // any ISR.
+        RunMachineTransitions(&masterMachine);
+        ensureButtonSampling();
         cli();
-        if (!focusedState)
+        if (HasRunLoopMessages(&mainRunLoop) || HasPendingMachineTransitions(&masterMachine))
         {
-            // No running states. Wait for all timer based activity to cease then go to sleep.
-            // INT0 can wake us back up.
-            if (!PRDS.isInterrupted && INDICATORSTATE_STOPPED == GetIndicatorState(&powerButtonIndicator))
-            {
-                sei();
-                set_sleep_mode(SLEEP_MODE_PWR_DOWN);
-                sleep_enable();
-                sleep_bod_disable();
-                sleep_cpu();
-                sleep_disable();
-                cli();
-            }
+            // Posted while we were draining.
+        }
+        else if (!focusedState)
+        {
+            // No running states. Power down once timer based activity has
+            // ceased. INT0 can wake us back up.
+            sleepUntilInterrupt();
+            cli();
         }
         else
         {
-            // TODO: drive this from a runloop and stop using the private _OnLoop method.
-            focusedState->_OnLoop(focusedState);
+            // TODO: drive this from a runloop.
+            MachineLoop(&masterMachine);
         }
         sei();
     }
@@ -11,20 +11,102 @@
 #include "Framework.h"
 #include "tinker/State.h"
 #include "Pulse.h"
+#include "IRProtocol.h"
+
+// +--[ EVENTS ]--------------------------------------------------------------+
+/**
+ * Events dispatched to the focused state. Unhandled events bubble up to the
+ * parent states. See DispatchMachineEvent.
+ */
+#define EVENT_BUTTON_CLICK 0
+#define EVENT_BUTTON_LONG_PRESS 1
+#define EVENT_BUTTON_DOUBLE_CLICK 2
+
+// +--[ ROOT ]----------------------------------------------------------------+
+/**
+ * Defined by the application. Every other state descends from it.
+ */
+extern State RootState;
 
 // +--[ RUNNING ]-------------------------------------------------------------+
-State* InitRunningState(State* newState, State* parentState, State* substates[], size_t substateCount);
+extern State RunningState;
 
 // +--[ VISUALIZE ]-----------------------------------------------------------+
-State* InitVisualizeState(State* newState, State* parentState);
+/**
+ * Mirrors the IR receiver onto the visual LED. Waits in idle at the full
+ * clock (POWER_PERIPHERAL_FULL_CLOCK) so every edge shows up at once. That
+ * costs milliamps for as long as the state is entered. Powering down
+ * would cost the first edge of each burst instead.
+ */
+extern State VisualizeState;
+
+void OnVisualizeLoop(State* state);
+
+/**
+ * Implemented by the application. Called when the button is clicked while
+ * visualizing.
+ */
+StateErrorType OnVisualizeClick(State* visualizeState, StateEventType event);
+
+/**
+ * Start/stop mirroring the IR receiver onto PINA_VISUAL from the pin change ISR.
+ */
+void StartVisualizeMirror();
+void StopVisualizeMirror();
 
 // +--[ CAPTURE ]-------------------------------------------------------------+
-typedef void (*OnPatternCaptureFunc)(State* captureState, Pulse* pulses, uint8_t pulseCount);
-typedef void (*OnPatternCaptureFailedFunc)(State* captureState);
+/**
+ * \struct Pattern
+ * A transmission to repeat. If code.protocol is IRPROTOCOL_UNKNOWN the
+ * transmission wasn't recognized and only the raw train can be replayed.
+ * Patterns loaded from the PatternStore have no train.
+ */
+typedef struct _PatternType
+{
+    IRCode code;
+    PulseTrain* train;
+    /**
+     * Times the train is sent again after the first, each after a space of
+     * trainGap PULSE_RESOLUTION_MICROS units. Capture keeps a single frame
+     * and stops once it sees it repeated so it only ever sets 0 or 1.
+     */
+    uint8_t trainRepeat;
+    uint16_t trainGap;
+    /**
+     * 1 to start transmitting as soon as RepeatingState is entered with this
+     * pattern rather than waiting for a click.
+     */
+    uint8_t playOnEntry;
+} Pattern;
+
+extern State CapturingState;
+
+/**
+ * Implemented by the application. Called when a pattern has been captured.
+ */
+void OnCapturePattern(State* captureState, Pattern* pattern);
+
+/**
+ * Implemented by the application. Called when a capture fails. Capturing
+ * starts over if the state is still entered afterwards so this must not block.
+ * \param failureCode  Why, as a number of blinks: 2 too many pulses, 4 lost
+ *                     edges, 6 too many distinct durations, 8 too few pulses,
+ *                     16 started mid-mark, 24 ended mid-mark.
+ */
+void OnCapturePatternFailed(State* captureState, uint8_t failureCode);
 
-State* InitCaptureState(State* newState, State* parentState, OnPatternCaptureFunc captureCallback, OnPatternCaptureFailedFunc captureFailedCallback);
+/**
+ * Implemented by the application. Called when the button is clicked before a
+ * pattern has been captured.
+ */
+StateErrorType OnCaptureClick(State* captureState, StateEventType event);
 
 // +--[ REPEAT ]--------------------------------------------------------------+
-State* InitRepeatState(State* newState, State* parentState);
+/**
+ * Enter with a Pattern (dataLen sizeof(Pattern)) that must stay valid until
+ * the state is exited. Mirrors the receiver between playbacks like
+ * VisualizeState, and pays the same full clock idle current to do it.
+ */
+extern State RepeatingState;
 
 #endif /* ALLSTATES_H_ */
@@ -5,67 +5,214 @@
 */
 
 #include "states/AllStates.h"
+#include "IRCapture.h"
 
-#define MAXPULSE_DURATION_MILLIS 65000
-#define RESOLUTION 20
-#define MAXPULSES 116
-#define MINIMUM_PULSE_COUNT 2
+/**
+ * Silence that ends a pattern. Longer than the space between the frames of a
+ * held button in any protocol we know of (NEC repeat frames leave ~96ms).
+ */
+#define END_OF_PATTERN_MILLIS 160
+#define MINIMUM_MARK_COUNT 2
 
+#define TICKS_PER_RESOLUTION IRCAPTURE_MICROS_TO_TICKS(PULSE_RESOLUTION_MICROS)
+#define END_OF_PATTERN_WRAPS IRCAPTURE_MILLIS_TO_WRAPS(END_OF_PATTERN_MILLIS)
+
+/**
+ * The train only holds the first frame while the frames after it are
+ * compared with it. If one matches the capture ends right there. If one
+ * doesn't, what was matched is copied in after the gap and the rest of the
+ * transmission is kept as is. Recognized codes also end the capture once the
+ * decoder sees them repeated, which covers repeat frames (NEC) that don't
+ * look like the first.
+ */
 typedef struct _CaptureDataType
 {
-    OnPatternCaptureFunc callback;
-    OnPatternCaptureFailedFunc failureCallback;
-    Pulse pulses[MAXPULSES]; // pair is high and low pulse
-    uint8_t _pulseCount;
+    Pattern pattern;
+    PulseTrain _train;
+    IRDecoder _decoder;
+    uint8_t _isStarted;
+    /**
+     * Edges in the first frame or 0 until its gap is seen.
+     */
+    uint16_t _frameEdges;
+    /**
+     * Edges of the current frame that matched the first one so far.
+     */
+    uint16_t _matchedEdges;
+    uint8_t _isMatching;
+    uint8_t _isRepeated;
 } CaptureData;
 
+static CaptureData _captureData;
+
 static void _notifyOfCapture(State* state)
 {
-    if (state && state->userData) {
-        CaptureData* data = (CaptureData*)state->userData;
-        if (data->callback)
+    CaptureData* data = (CaptureData*)StateGetUserData(state);
+    if (data)
+    {
+        OnCapturePattern(state, &data->pattern);
+    }
+}
+
+static void _notifyOfCaptureFailure(State* state, uint8_t failureCode)
+{
+    OnCapturePatternFailed(state, failureCode);
+}
+
+/**
+ * Convert an edge interval into PULSE_RESOLUTION_MICROS units.
+ */
+static uint16_t _edgeUnits(const IREdge* edge)
+{
+    const uint32_t units = (GetIREdgeTicks(edge) + (TICKS_PER_RESOLUTION / 2)) / TICKS_PER_RESOLUTION;
+    return (units > 0xFFFF) ? 0xFFFF : units;
+}
+
+/**
+ * Map a PulseTrain append result to a capture failure code.
+ */
+static uint8_t _appendUnits(CaptureData* data, uint16_t units)
+{
+    switch(AppendPulseTrainEdge(&data->_train, units))
+    {
+        case PULSETRAIN_FULL:
+            // Too many pulses
+            return 2;
+        case PULSETRAIN_NO_SYMBOLS:
+            // Too many distinct durations. Probably noise.
+            return 6;
+    }
+    return 0;
+}
+
+/**
+ * The frame being matched turned out to be different. Put the gap and the
+ * edges that did match into the train so it holds everything received.
+ */
+static uint8_t _stopMatching(CaptureData* data)
+{
+    uint8_t failureCode = _appendUnits(data, data->pattern.trainGap);
+    for (uint16_t i = 0; i < data->_matchedEdges && !failureCode; ++i)
+    {
+        failureCode = _appendUnits(data, GetPulseTrainEdge(&data->_train, i));
+    }
+    data->_isMatching = 0;
+    return failureCode;
+}
+
+static uint8_t _appendEdge(CaptureData* data, const IREdge* edge)
+{
+    const uint16_t units = _edgeUnits(edge);
+    const uint32_t micros = PulseUnitsToMicros(units);
+    const uint16_t decoderMicros = (micros > 0xFFFF) ? 0xFFFF : micros;
+    // Frames split exactly where the decoder splits them.
+    const uint8_t isGap = !(edge->flags & IREDGE_FLAG_MARK) && decoderMicros > IRPROTOCOL_FRAME_GAP_MICROS;
+    FeedIRDecoder(&data->_decoder, edge->flags & IREDGE_FLAG_MARK, decoderMicros);
+
+    if (isGap && IsIRDecoderRepeating(&data->_decoder))
+    {
+        // The code replaces the train so there's no need to hear the rest.
+        // Like any trailing gap this one isn't part of the pattern.
+        data->_isRepeated = 1;
+        return (data->_isMatching && data->_matchedEdges) ? _stopMatching(data) : 0;
+    }
+    if (isGap && !data->_frameEdges)
+    {
+        // End of the first frame. Hold the gap back, it's only part of the
+        // pattern if another frame follows.
+        data->_frameEdges = data->_train.edgeCount;
+        data->pattern.trainGap = units;
+        data->_matchedEdges = 0;
+        data->_isMatching = 1;
+        return 0;
+    }
+    if (data->_isMatching)
+    {
+        if (!isGap && IsPulseTrainEdgeMatch(&data->_train, data->_matchedEdges, units))
+        {
+            if (++data->_matchedEdges == data->_frameEdges)
+            {
+                data->pattern.trainRepeat = 1;
+                data->_isRepeated = 1;
+            }
+            return 0;
+        }
+        const uint8_t failureCode = _stopMatching(data);
+        if (failureCode)
         {
-            data->callback(state, data->pulses, data->_pulseCount);
+            return failureCode;
         }
     }
+    return _appendUnits(data, units);
 }
 
-static void _notifyOfCaptureFailure(State* state, uint8_t failureCode)
+static void _resetCapture(CaptureData* data)
 {
-    uint8_t buttonison = IS_PIN_HIGH(A, 0);
+    PulseTrainInit(&data->_train);
+    data->pattern.train = &data->_train;
+    IRDecoderInit(&data->_decoder);
+    data->pattern.code.protocol = IRPROTOCOL_UNKNOWN;
+    data->pattern.trainRepeat = 0;
+    data->pattern.trainGap = 0;
+    data->pattern.playOnEntry = 0;
+    data->_isStarted = 0;
+    data->_frameEdges = 0;
+    data->_matchedEdges = 0;
+    data->_isMatching = 0;
+    data->_isRepeated = 0;
+    mirrorOntoVisualPin(0);
+}
 
-    
-    if (buttonison)
+static void _finishCapture(State* state, CaptureData* data, uint8_t failureCode)
+{
+    StopIRCapture();
+    if (failureCode)
     {
-        SETPIN_LOW(A, 0);
+        _notifyOfCaptureFailure(state, failureCode);
     }
-    
-    SETPIN_LOW(A, 1); 
-    _delay_ms(500);
-    
-    while(failureCode > 0)
+    else
     {
-        SETPIN_HIGH(A, 1);
-        _delay_ms(110);
-        SETPIN_LOW(A, 1);
-        _delay_ms(90);
-        --failureCode;
+        _notifyOfCapture(state);
     }
-    
-    _delay_ms(500);
-    
-    if (buttonison)
+
+    if (StateIsEntered(state))
     {
-        SETPIN_HIGH(A, 0);
+        // Still capturing (e.g. the failure callback declined to leave). Start over.
+        _resetCapture(data);
+        StartIRCapture();
     }
+}
 
-    if (state && state->userData) {
-        CaptureData* data = (CaptureData*)state->userData;
-        if (data->callback)
+/**
+ * Fold one edge into the pattern.
+ * \return 0 to keep capturing, or a failure code.
+ */
+static uint8_t _captureEdge(CaptureData* data, const IREdge* edge)
+{
+    if (edge->flags & IREDGE_FLAG_MARK)
+    {
+        mirrorOntoVisualPin(0);
+        if (!data->_isStarted)
+        {
+            // Expected the pin to be low.
+            return 16;
+        }
+        return _appendEdge(data, edge);
+    }
+    else
+    {
+        mirrorOntoVisualPin(1);
+        if (!data->_isStarted)
+        {
+            // Silence before the first mark is not part of the pattern.
+            data->_isStarted = 1;
+        }
+        else
         {
-            data->failureCallback(state);
+            return _appendEdge(data, edge);
         }
     }
+    return 0;
 }
 
 // +--------------------------------------------------------------------------+
@@ -73,157 +220,98 @@ static void _notifyOfCaptureFailure(State* state, uint8_t failureCode)
 // +--------------------------------------------------------------------------+
 StateErrorType OnEnterCaptureState(State* state, void* data, uint8_t datalen)
 {
-    PORTA &= ~_BV(PINA_VISUAL);
+    _resetCapture((CaptureData*)StateGetUserData(state));
+    StartIRCapture();
     return STATE_ERROR_NONE;
 }
 
 StateErrorType OnExitCaptureState(State* state, void* data, uint8_t datalen)
 {
-    PORTA &= ~_BV(PINA_VISUAL);
+    StopIRCapture();
+    mirrorOntoVisualPin(0);
     return STATE_ERROR_NONE;
 }
 
 /**
-* Timestable function to both pause for a fixed period and schedule some animation time
-* for the main runloop.
-*/
-static inline uint16_t _doTickAndHandleRunloop(uint16_t lastticks)
+ * Drains the edges timestamped by the capture ISR into the pattern. The
+ * durations are latched by Timer1 so how late we get around to this (run loop
+ * work, indicator animation, etc) has no effect on them.
+ */
+void OnCaptureLoop(State* state)
 {
-    if (lastticks >= 1000)
+    CaptureData* data = (CaptureData*)StateGetUserData(state);
+    uint8_t failureCode = 0;
+    IREdge edge;
+
+    sei();
+
+    while (!failureCode && !data->_isRepeated && StateIsEntered(state) && ReadIRCaptureEdge(&edge))
     {
-        driveMainRunLoop(1);
-        lastticks += RESOLUTION - 2;
-        _delay_us(RESOLUTION - 2);
-        lastticks = 0;
-        } else {
-        lastticks += RESOLUTION;
-        _delay_us(RESOLUTION);
+        failureCode = _captureEdge(data, &edge);
     }
-    return lastticks;
-}
 
-void OnCaptureLoop(State* state)
-{
-    PORTA &= ~_BV(PINA_VISUAL);
-    uint8_t currentpulse = 0;
-    uint16_t highpulse, lowpulse; // temporary storage timing
-    highpulse = lowpulse = 0; // start out with no pulse length
-    CaptureData* data = (CaptureData*)state->userData;
-    data->_pulseCount = 0;
-    uint16_t localtime = 0;
-    
-    disableMainLoopTimer();
-    sei();
-    
-    while (IS_PIN_HIGH(A, 7) && StateIsEntered(state))
+    if (!StateIsEntered(state))
     {
-        localtime = _doTickAndHandleRunloop(localtime);
+        return;
     }
-    
-    while(StateIsEntered(state) && currentpulse < MAXPULSES)
+
+    if (!failureCode && HasIRCaptureOverrun())
     {
-        highpulse = 2;
-        
-        PORTA |= _BV(PINA_VISUAL);
-        
-        while (!IS_PIN_HIGH(A, 7))
+        // Lost edges so the pattern is no good.
+        failureCode = 4;
+    }
+
+    if (failureCode)
+    {
+        _finishCapture(state, data, failureCode);
+    }
+    else if (data->_isRepeated)
+    {
+        // A frame just like the first or a recognized repeat. Don't wait for
+        // the rest of them.
+        FinishIRDecoder(&data->_decoder, &data->pattern.code);
+        _finishCapture(state, data, 0);
+    }
+    else if (data->_isStarted && GetIRCaptureSilence() >= END_OF_PATTERN_WRAPS)
+    {
+        if (data->_isMatching && data->_matchedEdges)
         {
-            
-            if (highpulse == 0xFFFF)
-            {
-                // Capture must complete with the ir sensor pin HIGH
-                _notifyOfCaptureFailure(state, 24);
-                goto STATE_CAPTURE_DONE;
-            }
-            else
-            {
-                ++highpulse;
-            }
-            
-            localtime = _doTickAndHandleRunloop(localtime);
-            if (!StateIsEntered(state))
-            {
-                goto STATE_CAPTURE_DONE;
-            }
+            // Ended partway through a frame that started like the first.
+            failureCode = _stopMatching(data);
         }
-        
-        PORTA &= ~_BV(PINA_VISUAL);
-        
-        if (highpulse == 2)
+        if (failureCode)
         {
-            // Expected the pin to be high.
-            _notifyOfCaptureFailure(state, 4);
-            goto STATE_CAPTURE_DONE;
+            _finishCapture(state, data, failureCode);
         }
-         
-        data->pulses[currentpulse].high = (highpulse < 0x7F) ? 0x7F & highpulse : 0x80 | (0x7f & (highpulse >> 8));
-        
-        lowpulse = 1;
-        
-        while (IS_PIN_HIGH(A, 7))
+        else if (!IS_PIN_HIGH(A, 7))
         {
-            if (lowpulse == 0xFFFF)
-            {
-                data->pulses[currentpulse++].low = 0xFF;
-                
-                if(currentpulse > MINIMUM_PULSE_COUNT)
-                {
-                    data->_pulseCount = currentpulse;
-                    _notifyOfCapture(state);
-                    currentpulse = 0;
-                    goto STATE_CAPTURE_DONE;
-                }
-                else
-                {
-                    // Not enough pulses found.
-                    _notifyOfCaptureFailure(state, 8);
-                    goto STATE_CAPTURE_DONE;
-                }
-            }
-            else
-            {
-                ++lowpulse;
-            }
-            
-            localtime = _doTickAndHandleRunloop(localtime);
-            if (!StateIsEntered(state))
-            {
-                goto STATE_CAPTURE_DONE;
-            }
+            // Capture must complete with the ir sensor pin HIGH
+            _finishCapture(state, data, 24);
         }
-        
-        if (lowpulse == 1)
+        else if (data->_train.edgeCount >= (MINIMUM_MARK_COUNT * 2) - 1)
         {
-            // Expected the pin to be low.
-            _notifyOfCaptureFailure(state, 16);
-            goto STATE_CAPTURE_DONE;
+            // The silence that ended the pattern is not part of it. If the
+            // protocol was recognized the code replaces the raw train.
+            FinishIRDecoder(&data->_decoder, &data->pattern.code);
+            _finishCapture(state, data, 0);
+        }
+        else
+        {
+            // Not enough pulses found.
+            _finishCapture(state, data, 8);
         }
-        
-        data->pulses[currentpulse++].low = (lowpulse < 0x7F) ? 0x7F & lowpulse : 0x80 | (0x7f & (lowpulse >> 8));
     }
-    
-    if (StateIsEntered(state))
+
+    cli();
+    if (StateIsEntered(state) && !HasIRCaptureEdges())
     {
-        // Too many pulses
-        _notifyOfCaptureFailure(state,2);
+        // Nothing to do until the next edge (or timer tick).
+        sleepUntilInterrupt();
     }
-    
-STATE_CAPTURE_DONE:
-    cli();
-    enableMainLoopTimer();
-    
-    return;
 }
+
+static const StateEventFunc _captureEvents[] TINKER_PROGMEM = {
+    [EVENT_BUTTON_CLICK] = OnCaptureClick,
+};
 
-State* InitCaptureState(State* newState, State* parentState, OnPatternCaptureFunc captureCallback, OnPatternCaptureFailedFunc captureFailedCallback)
-{
-    newState = StateInit(newState, parentState, OnEnterCaptureState, OnExitCaptureState, OnCaptureLoop);
-    if (newState) {
-        CaptureData* data = malloc(sizeof(CaptureData));
-        data->_pulseCount = 0;
-        data->callback = captureCallback;
-        data->failureCallback = captureFailedCallback;
-        newState->userData = data;
-    }
-    return newState;
-}
+TINKER_STATE(CapturingState, &RunningState, OnEnterCaptureState, OnExitCaptureState, OnCaptureLoop, TINKER_EVENTS(_captureEvents), TINKER_POWER(POWER_SLEEP_IDLE, POWER_PERIPHERAL_TIMER1), &_captureData);
@@ -5,72 +5,169 @@
 */
 
 #include "states/AllStates.h"
+#include "IRPlayback.h"
+
+/**
+ * Carrier for patterns that weren't recognized.
+ */
+#define REPEAT_CARRIER IRPLAYBACK_CARRIER_38KHZ
 
 typedef struct _RepeatData
 {
-    Pulse* pulses;
-    uint8_t pulseCount;
+    Pattern* pattern;
+    IREncoder _encoder;
+    uint16_t _nextEdge;
+    uint8_t _repeatsLeft;
+    uint8_t _isPlaying;
+    uint8_t _isEncoding;
 } RepeatData;
 
-extern void OnVisualizeLoop(State* state);
+static RepeatData _repeatData;
+
+/**
+ * Queue as much of the pattern as the playback engine will take.
+ */
+static void _feedPlayback(RepeatData* repeatData)
+{
+    if (repeatData->_isEncoding)
+    {
+        uint32_t mark;
+        uint32_t space;
+        while (!IsIRPlaybackQueueFull())
+        {
+            if (!NextIREncoderPair(&repeatData->_encoder, &mark, &space))
+            {
+                FinishIRPlayback();
+                return;
+            }
+            QueueIRPlayback(mark, space);
+        }
+        return;
+    }
+
+    const PulseTrain* train = repeatData->pattern->train;
+    while (train && repeatData->_nextEdge < train->edgeCount)
+    {
+        const uint16_t i = repeatData->_nextEdge;
+        // The train ends with a mark. GetPulseTrainEdge gives 0 for the
+        // missing space so we don't wait after the last mark, unless the
+        // train goes out again.
+        const uint8_t isLast = (i + 1 >= train->edgeCount);
+        const uint16_t space = (isLast && repeatData->_repeatsLeft) ? repeatData->pattern->trainGap : GetPulseTrainEdge(train, i + 1);
+        if (!QueueIRPlayback(PulseUnitsToMicros(GetPulseTrainEdge(train, i)), PulseUnitsToMicros(space)))
+        {
+            return;
+        }
+        repeatData->_nextEdge = i + 2;
+        if (isLast && repeatData->_repeatsLeft)
+        {
+            --repeatData->_repeatsLeft;
+            repeatData->_nextEdge = 0;
+        }
+    }
+    FinishIRPlayback();
+}
+
+static void _stopPlayback(RepeatData* repeatData)
+{
+    StopIRPlayback();
+    repeatData->_isPlaying = 0;
+    repeatData->_nextEdge = 0;
+    StartVisualizeMirror();
+}
+
+/**
+ * Transmit the pattern unless it is already going out.
+ */
+static void _startPlayback(RepeatData* repeatData)
+{
+    if (repeatData->pattern && !repeatData->_isPlaying)
+    {
+        const IRCode* code = &repeatData->pattern->code;
+        repeatData->_isPlaying = 1;
+        repeatData->_nextEdge = 0;
+        repeatData->_repeatsLeft = repeatData->pattern->trainRepeat;
+        // Synthesize recognized codes rather than replaying the noise we captured.
+        repeatData->_isEncoding = (0 != IREncoderInit(&repeatData->_encoder, code));
+        // Playback drives the visual indicator while transmitting.
+        StopVisualizeMirror();
+        StartIRPlayback(repeatData->_isEncoding ? GetIRProtocolCarrier(code->protocol) : REPEAT_CARRIER);
+        _feedPlayback(repeatData);
+    }
+}
 
 StateErrorType OnEnterRepeatState(State* state, void* data, uint8_t datalen)
 {
-    PORTA &= ~_BV(PINA_VISUAL);
-    RepeatData* repeatData = (RepeatData*)state->userData;
+    StartVisualizeMirror();
+    RepeatData* repeatData = (RepeatData*)StateGetUserData(state);
     if (repeatData)
     {
-        repeatData->pulses = (Pulse*)data;
-        repeatData->pulseCount = datalen;
+        repeatData->pattern = (sizeof(Pattern) == datalen) ? (Pattern*)data : 0;
+        repeatData->_nextEdge = 0;
+        repeatData->_isPlaying = 0;
+        if (repeatData->pattern && repeatData->pattern->playOnEntry)
+        {
+            _startPlayback(repeatData);
+        }
     }
     return STATE_ERROR_NONE;
 }
 
 StateErrorType OnExitRepeatState(State* state, void* data, uint8_t datalen)
 {
-    PORTA &= ~_BV(PINA_VISUAL);
+    RepeatData* repeatData = (RepeatData*)StateGetUserData(state);
+    if (repeatData && repeatData->_isPlaying)
+    {
+        StopIRPlayback();
+        repeatData->_isPlaying = 0;
+    }
+    StopVisualizeMirror();
     return STATE_ERROR_NONE;
 }
 
-StateErrorType OnInterruptRepeatState(State* state, StateInterruptType interruptType)
+/**
+ * A click (or double click) transmits the pattern.
+ */
+StateErrorType OnRepeatClick(State* state, StateEventType event)
 {
-    RepeatData* repeatData = (RepeatData*)state->userData;
+    RepeatData* repeatData = (RepeatData*)StateGetUserData(state);
     if (repeatData)
     {
-        for(uint8_t i = 0; i < repeatData->pulseCount; ++i)
-        {
-            Pulse pulse = repeatData->pulses[i];
-            SETPIN_HIGH(A, 1);
-            SETPIN_HIGH(A, 2);
-            uint16_t pulseHigh = (0x80 & pulse.high) ? ((uint16_t)(0x7f & pulse.high) << 8) : pulse.high;
-            for(uint16_t x = 0; x < pulseHigh; ++x)
-            {
-                _delay_us(22);
-            }
-            SETPIN_LOW(A, 1);
-            SETPIN_LOW(A, 2);
-            uint16_t pulseLow =(0x80 & pulse.low) ? ((uint16_t)(0x7f & pulse.low) << 8) : pulse.low;
-            // The last low pulse is just the end of the transmission. Don't
-            // block on it.
-            if (i < repeatData->pulseCount - 1)
-            {
-                for(uint16_t x = 0; x < pulseLow; ++x)
-                {
-                    _delay_us(21);
-                }
-            }
-        }
+        _startPlayback(repeatData);
     }
     return STATE_ERROR_NONE;
 }
 
-State* InitRepeatState(State* newState, State* parentState)
+/**
+ * Keeps the playback engine fed while a pattern is transmitting. Otherwise
+ * behaves like the visualize state.
+ */
+void OnRepeatLoop(State* state)
 {
-    newState = StateInit(newState, parentState, OnEnterRepeatState, OnExitRepeatState, OnVisualizeLoop);
-    if (newState)
+    RepeatData* repeatData = (RepeatData*)StateGetUserData(state);
+    if (repeatData && repeatData->_isPlaying)
     {
-        newState->userData = malloc(sizeof(RepeatData));
-        newState->OnInterrupt = OnInterruptRepeatState;
+        if (IsIRPlaybackActive())
+        {
+            _feedPlayback(repeatData);
+            sleepUntilInterrupt();
+        }
+        else
+        {
+            _stopPlayback(repeatData);
+        }
     }
-    return newState;
-}
\ No newline at end of file
+    else
+    {
+        OnVisualizeLoop(state);
+    }
+}
+
+static const StateEventFunc _repeatEvents[] TINKER_PROGMEM = {
+    [EVENT_BUTTON_CLICK] = OnRepeatClick,
+    [EVENT_BUTTON_DOUBLE_CLICK] = OnRepeatClick,
+};
+
+// Mirrors the receiver between playbacks, so idle at full clock like
+// VisualizeState, trading the same idle current for edge latency.
+TINKER_STATE(RepeatingState, &RunningState, OnEnterRepeatState, OnExitRepeatState, OnRepeatLoop, TINKER_EVENTS(_repeatEvents), TINKER_POWER(POWER_SLEEP_IDLE, POWER_PERIPHERAL_TIMER1 | POWER_PERIPHERAL_FULL_CLOCK), &_repeatData);
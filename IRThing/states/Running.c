@@ -18,7 +18,4 @@ StateErrorType OnExitRunningState(State* state, void* data, uint8_t datalen)
     return STATE_ERROR_NONE;
 }
 
-State* InitRunningState(State* newState, State* parentState, State* substates[], size_t substateCount)
-{
-    return StateInitWSubstates(newState, parentState, OnEnterRunningState, OnExitRunningState, 0, substates, substateCount);
-}
+TINKER_STATE(RunningState, &RootState, OnEnterRunningState, OnExitRunningState, 0, TINKER_NO_EVENTS, TINKER_ANY_POWER, 0);
@@ -5,37 +5,66 @@
 */
 #include "states/AllStates.h"
 
-void OnVisualizeLoop(State* state)
+/**
+ * Mirror the IR receiver onto the visual indicator. The receiver idles high
+ * so the LED is lit while a mark is being received.
+ */
+static inline void _mirrorIRInput()
 {
-    if (!(PINA & _BV(PINA_IR_IN)))
+    mirrorOntoVisualPin(!(PINA & _BV(PINA_IR_IN)));
+}
+
+void StartVisualizeMirror()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        PORTA |= _BV(PINA_VISUAL);
+        PCMSK0 |= _BV(PCINT7);
+        CLEAR_INTERRUPT_FLAGS(GIFR, _BV(PCIF0));
+        GIMSK |= _BV(PCIE0);
+        _mirrorIRInput();
     }
-    else
+}
+
+void StopVisualizeMirror()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        PORTA &= ~_BV(PINA_VISUAL);
+        GIMSK &= ~_BV(PCIE0);
+        PCMSK0 &= ~_BV(PCINT7);
+        mirrorOntoVisualPin(0);
     }
-    _delay_us(5);
+}
+
+ISR(PCINT0_vect)
+{
+    _mirrorIRInput();
+}
+
+void OnVisualizeLoop(State* state)
+{
+    // The pin change ISR does all the work.
+    sleepUntilInterrupt();
 }
 
 StateErrorType OnEnterVisualizeState(State* state, void* data, uint8_t datalen)
 {
-    PORTA &= ~_BV(PINA_VISUAL);
+    StartVisualizeMirror();
     return STATE_ERROR_NONE;
 }
 
 StateErrorType OnExitVisualizeState(State* state, void* data, uint8_t datalen)
 {
-    PORTA &= ~_BV(PINA_VISUAL);
+    StopVisualizeMirror();
     return STATE_ERROR_NONE;
 }
 
-State* InitVisualizeState(State* newState, State* parentState)
-{
-    newState = StateInit(newState, parentState, OnEnterVisualizeState, OnExitVisualizeState, OnVisualizeLoop);
-    if (newState)
-    {
-                
-    }
-    return newState;
-}
+static const StateEventFunc _visualizeEvents[] TINKER_PROGMEM = {
+    [EVENT_BUTTON_CLICK] = OnVisualizeClick,
+};
+
+// Idle at full clock rather than power down or slow down. The crystal takes
+// most of a millisecond to restart after power down and the mirror interrupt
+// takes 16 times as long on the slow clock. Either would delay every edge;
+// power down would swallow the first edge of a burst entirely. The price is
+// idle current at 20 MHz for as long as the mirror is on.
+TINKER_STATE(VisualizeState, &RunningState, OnEnterVisualizeState, OnExitVisualizeState, OnVisualizeLoop, TINKER_EVENTS(_visualizeEvents), TINKER_POWER(POWER_SLEEP_IDLE, POWER_PERIPHERAL_FULL_CLOCK), 0);
@@ -0,0 +1,34 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file Check.h
+ * The little the host unit tests need: CHECK reports a failed condition and
+ * keeps going so one run shows every failure, CHECK_RESULT is what main
+ * returns. Include once per test executable.
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint8_t _checkFailures;
+
+static inline void _check(int isTrue, const char* file, int line, const char* what)
+{
+    if (!isTrue)
+    {
+        fprintf(stderr, "%s:%d: FAILED: %s\n", file, line, what);
+        ++_checkFailures;
+    }
+}
+
+#define CHECK(CONDITION) _check((CONDITION), __FILE__, __LINE__, #CONDITION)
+
+#define CHECK_RESULT() ((_checkFailures) ? 1 : 0)
+
+#endif /* CHECK_H_ */
@@ -0,0 +1,196 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Unit tests for ButtonGroup debouncing and Gesture timing, wired together
+ * the way the firmware wires them: one sample a millisecond feeding a group
+ * whose down and up events feed a gesture.
+ */
+
+#include "Check.h"
+#include "TestClock.h"
+#include "tinker/ButtonGroup.h"
+#include "tinker/Gesture.h"
+
+#define _BUTTON 0x01
+#define _HOLD_MILLIS 1000
+#define _REPEAT_MILLIS 200
+#define _DEBOUNCE_MILLIS 7
+#define _MAX_PRESSES 3
+#define _MAX_EVENTS 8
+
+typedef struct
+{
+    uint32_t at;
+    uint8_t event;
+    uint8_t count;
+} _Event;
+
+static TimerService _service;
+static ButtonGroup _group;
+static Gesture _gesture;
+
+/**
+ * Each press is held from its first to its second millisecond.
+ */
+static uint32_t _presses[_MAX_PRESSES][2];
+static uint8_t _pressCount;
+
+static _Event _gestureEvents[_MAX_EVENTS];
+static uint8_t _gestureEventCount;
+static uint8_t _doubleClicks;
+
+static void _onTick(uint32_t now)
+{
+    uint8_t sample = _BUTTON;
+    for (uint8_t i = 0; i < _pressCount; ++i)
+    {
+        if (now >= _presses[i][0] && now < _presses[i][1])
+        {
+            // Active low.
+            sample = 0;
+        }
+    }
+    ButtonGroupSample(&_group, sample);
+}
+
+static void _onButtonEvent(ButtonGroup* source, ButtonEventType event, uint8_t buttons)
+{
+    if (BUTTON_EVENT_DOUBLE_CLICK == event)
+    {
+        ++_doubleClicks;
+    }
+    GestureHandleButtonEvent(&_gesture, event);
+}
+
+static void _onGestureEvent(Gesture* source, GestureEventType event, uint8_t count)
+{
+    if (_gestureEventCount < _MAX_EVENTS)
+    {
+        _Event* logged = &_gestureEvents[_gestureEventCount++];
+        logged->at = TestClockNow();
+        logged->event = event;
+        logged->count = count;
+    }
+}
+
+static void _reset(void)
+{
+    RunLoop* runLoop = TestClockInit(&_service, _onTick);
+    CHECK(&_group == ButtonGroupInit(&_group, _BUTTON, _BUTTON, _onButtonEvent, runLoop));
+    GestureInit(&_gesture, _onGestureEvent, &_service, _HOLD_MILLIS, _REPEAT_MILLIS);
+    _pressCount = 0;
+    _gestureEventCount = 0;
+    _doubleClicks = 0;
+}
+
+static void _press(uint32_t from, uint32_t to)
+{
+    _presses[_pressCount][0] = from;
+    _presses[_pressCount][1] = to;
+    ++_pressCount;
+}
+
+static uint8_t _isEvent(uint8_t index, uint32_t at, uint8_t event, uint8_t count)
+{
+    if (index >= _gestureEventCount)
+    {
+        fprintf(stderr, "event %u missing\n", index);
+        return 0;
+    }
+    const _Event* logged = &_gestureEvents[index];
+    if (logged->at != at || logged->event != event || logged->count != count)
+    {
+        fprintf(stderr, "event %u: expected %u(%u) at %u got %u(%u) at %u\n", index, event, count, (unsigned)at, logged->event,
+                logged->count, (unsigned)logged->at);
+        return 0;
+    }
+    return 1;
+}
+
+static void _testBounceIsIgnored(void)
+{
+    _reset();
+    _press(100, 104);
+    _press(106, 110);
+    TestClockAdvance(1000);
+    CHECK(0 == _gestureEventCount);
+    CHECK(IsButtonGroupSettled(&_group));
+}
+
+static void _testClick(void)
+{
+    _reset();
+    _press(100, 200);
+    TestClockAdvance(1000);
+    CHECK(2 == _gestureEventCount);
+    CHECK(_isEvent(0, 200 + _DEBOUNCE_MILLIS, GESTURE_EVENT_CLICK, 1));
+    CHECK(_isEvent(1, 200 + _DEBOUNCE_MILLIS + GESTURE_MULTICLICK_MILLIS, GESTURE_EVENT_CLICKS_DONE, 1));
+    CHECK(0 == _doubleClicks);
+}
+
+static void _testDoubleClick(void)
+{
+    _reset();
+    _press(100, 200);
+    _press(300, 400);
+    TestClockAdvance(1000);
+    CHECK(3 == _gestureEventCount);
+    CHECK(_isEvent(0, 200 + _DEBOUNCE_MILLIS, GESTURE_EVENT_CLICK, 1));
+    CHECK(_isEvent(1, 400 + _DEBOUNCE_MILLIS, GESTURE_EVENT_CLICK, 2));
+    CHECK(_isEvent(2, 400 + _DEBOUNCE_MILLIS + GESTURE_MULTICLICK_MILLIS, GESTURE_EVENT_CLICKS_DONE, 2));
+    CHECK(1 == _doubleClicks);
+}
+
+static void _testSlowSecondClickStartsOver(void)
+{
+    _reset();
+    _press(100, 200);
+    // Pressed again just after the multi-click window closed.
+    _press(200 + _DEBOUNCE_MILLIS + GESTURE_MULTICLICK_MILLIS, 600);
+    TestClockAdvance(1500);
+    CHECK(4 == _gestureEventCount);
+    CHECK(_isEvent(1, 200 + _DEBOUNCE_MILLIS + GESTURE_MULTICLICK_MILLIS, GESTURE_EVENT_CLICKS_DONE, 1));
+    CHECK(_isEvent(2, 600 + _DEBOUNCE_MILLIS, GESTURE_EVENT_CLICK, 1));
+    CHECK(_isEvent(3, 600 + _DEBOUNCE_MILLIS + GESTURE_MULTICLICK_MILLIS, GESTURE_EVENT_CLICKS_DONE, 1));
+}
+
+static void _testHold(void)
+{
+    _reset();
+    const uint32_t down = 100 + _DEBOUNCE_MILLIS;
+    _press(100, 100 + _HOLD_MILLIS + _REPEAT_MILLIS * 2 + 50);
+    TestClockAdvance(3000);
+    CHECK(4 == _gestureEventCount);
+    CHECK(_isEvent(0, down + _HOLD_MILLIS, GESTURE_EVENT_HOLD, 0));
+    CHECK(_isEvent(1, down + _HOLD_MILLIS + _REPEAT_MILLIS, GESTURE_EVENT_HOLD_REPEAT, 1));
+    CHECK(_isEvent(2, down + _HOLD_MILLIS + _REPEAT_MILLIS * 2, GESTURE_EVENT_HOLD_REPEAT, 2));
+    CHECK(_isEvent(3, down + _HOLD_MILLIS + _REPEAT_MILLIS * 2 + 50, GESTURE_EVENT_HOLD_RELEASE, 2));
+    CHECK(!HasScheduledTimers(&_service));
+}
+
+static void _testClickThenHold(void)
+{
+    _reset();
+    _press(100, 200);
+    _press(300, 300 + _HOLD_MILLIS + 100);
+    TestClockAdvance(3000);
+    CHECK(3 == _gestureEventCount);
+    CHECK(_isEvent(0, 200 + _DEBOUNCE_MILLIS, GESTURE_EVENT_CLICK, 1));
+    // The hold reports the click before it.
+    CHECK(_isEvent(1, 300 + _DEBOUNCE_MILLIS + _HOLD_MILLIS, GESTURE_EVENT_HOLD, 1));
+    CHECK(_isEvent(2, 300 + _DEBOUNCE_MILLIS + _HOLD_MILLIS + 100, GESTURE_EVENT_HOLD_RELEASE, 0));
+}
+
+int main(void)
+{
+    _testBounceIsIgnored();
+    _testClick();
+    _testDoubleClick();
+    _testSlowSecondClickStartsOver();
+    _testHold();
+    _testClickThenHold();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,116 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Unit tests for IRProtocol: every supported protocol encoded and decoded
+ * back, both as generated and with receiver distortion.
+ */
+
+#include "Check.h"
+#include "IRProtocol.h"
+
+/**
+ * Receivers stretch marks and shorten spaces. Stay inside
+ * IRPROTOCOL_TOLERANCE_MICROS so the distortion alone can't fail a decode.
+ */
+#define _STRETCH_MICROS 40
+
+static const IRCode _codes[] = {
+    { IRPROTOCOL_NEC, 0, 0x04, 0x08, 0 },
+    { IRPROTOCOL_NEC, 0, 0x1234, 0x56, 1 },
+    { IRPROTOCOL_SAMSUNG, 0, 0x07, 0x02, 0 },
+    // A 16 bit Samsung address with equal bytes decodes as 8 bits.
+    { IRPROTOCOL_SAMSUNG, 0, 0x0E07, 0xE6, 1 },
+    { IRPROTOCOL_SIRC12, 0, 0x01, 0x15, 0 },
+    { IRPROTOCOL_SIRC12, 0, 0x1F, 0x7F, 0 },
+    { IRPROTOCOL_SIRC15, 0, 0xA4, 0x2A, 0 },
+    { IRPROTOCOL_SIRC20, 0, 0x1A3B, 0x33, 0 },
+    { IRPROTOCOL_RC5, 0, 0x00, 0x0C, 0 },
+    { IRPROTOCOL_RC5, 0, 0x1F, 0x7F, 0 },
+    { IRPROTOCOL_RC6, 0, 0x00, 0x0C, 0 },
+    { IRPROTOCOL_RC6, 0, 0xFF, 0xA5, 0 },
+    { IRPROTOCOL_NEC, 2, 0x04, 0x08, 0 },
+    { IRPROTOCOL_SIRC12, 2, 0x01, 0x15, 0 },
+    { IRPROTOCOL_RC5, 1, 0x05, 0x35, 0 },
+    { IRPROTOCOL_RC6, 1, 0x26, 0x5C, 0 },
+};
+
+static uint16_t _clamp(uint32_t micros)
+{
+    return (micros > 0xFFFF) ? 0xFFFF : micros;
+}
+
+/**
+ * Encode code, feed the result to a decoder and return what it decoded.
+ */
+static uint8_t _roundTrip(const IRCode* code, int16_t stretch, IRCode* decoded)
+{
+    IREncoder encoder;
+    IRDecoder decoder;
+    if (!IREncoderInit(&encoder, code))
+    {
+        return 0;
+    }
+    IRDecoderInit(&decoder);
+    uint32_t mark;
+    uint32_t space;
+    while (NextIREncoderPair(&encoder, &mark, &space))
+    {
+        FeedIRDecoder(&decoder, 1, _clamp(mark + stretch));
+        if (space)
+        {
+            FeedIRDecoder(&decoder, 0, _clamp(space - stretch));
+        }
+    }
+    return FinishIRDecoder(&decoder, decoded);
+}
+
+static uint8_t _isSameCode(const IRCode* a, const IRCode* b)
+{
+    return (a->protocol == b->protocol && a->repeat == b->repeat && a->address == b->address && a->command == b->command &&
+            a->isExtended == b->isExtended);
+}
+
+static void _testRoundTrips(int16_t stretch)
+{
+    for (uint8_t i = 0; i < sizeof(_codes) / sizeof(_codes[0]); ++i)
+    {
+        const IRCode* code = &_codes[i];
+        IRCode decoded = { IRPROTOCOL_UNKNOWN, 0, 0, 0, 0 };
+        const uint8_t isDecoded = _roundTrip(code, stretch, &decoded);
+        if (!isDecoded || !_isSameCode(code, &decoded))
+        {
+            fprintf(stderr, "code %u (stretch %d): sent %u/%u %04x %02x got %u %u/%u %04x %02x\n", i, stretch, code->protocol, code->repeat,
+                    code->address, code->command, isDecoded, decoded.protocol, decoded.repeat, decoded.address, decoded.command);
+            CHECK(!"round trip");
+        }
+    }
+}
+
+static void _testUnknownProtocolIsNotEncoded(void)
+{
+    IREncoder encoder;
+    const IRCode unknown = { IRPROTOCOL_UNKNOWN, 0, 0, 0, 0 };
+    CHECK(0 == IREncoderInit(&encoder, &unknown));
+}
+
+static void _testCarriers(void)
+{
+    CHECK(IRPLAYBACK_CARRIER_38KHZ == GetIRProtocolCarrier(IRPROTOCOL_NEC));
+    CHECK(IRPLAYBACK_CARRIER_38KHZ == GetIRProtocolCarrier(IRPROTOCOL_SAMSUNG));
+    CHECK(IRPLAYBACK_CARRIER_40KHZ == GetIRProtocolCarrier(IRPROTOCOL_SIRC12));
+    CHECK(IRPLAYBACK_CARRIER_40KHZ == GetIRProtocolCarrier(IRPROTOCOL_SIRC20));
+    CHECK(IRPLAYBACK_CARRIER_36KHZ == GetIRProtocolCarrier(IRPROTOCOL_RC5));
+    CHECK(IRPLAYBACK_CARRIER_36KHZ == GetIRProtocolCarrier(IRPROTOCOL_RC6));
+}
+
+int main(void)
+{
+    _testRoundTrips(0);
+    _testRoundTrips(_STRETCH_MICROS);
+    _testUnknownProtocolIsNotEncoded();
+    _testCarriers();
+    return CHECK_RESULT();
+}
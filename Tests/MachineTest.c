@@ -0,0 +1,252 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Unit tests for Machine: transitions between every pair of states (so every
+ * entry of the least common ancestor table), the pending queue, event
+ * bubbling, loop functions and power.
+ *
+ *   Root
+ *   +-- A
+ *   |   +-- A1
+ *   |   +-- A2
+ *   +-- B
+ *       +-- B1
+ */
+
+#include "Check.h"
+#include "tinker/Machine.h"
+#include <string.h>
+
+#define _EVENT_PING 0
+#define _EVENT_PONG 1
+
+static char _log[64];
+static uint8_t _refuseEnter;
+
+static void _record(const char* what)
+{
+    strncat(_log, what, sizeof(_log) - strlen(_log) - 1);
+}
+
+static const char* _name(State* state);
+
+static StateErrorType _onEnter(State* state, void* data, uint8_t datalen)
+{
+    _record("+");
+    _record(_name(state));
+    return (_refuseEnter) ? STATE_ERROR_INVALID : STATE_ERROR_NONE;
+}
+
+static StateErrorType _onExit(State* state, void* data, uint8_t datalen)
+{
+    _record("-");
+    _record(_name(state));
+    return STATE_ERROR_NONE;
+}
+
+static void _onLoop(State* state)
+{
+    _record("@");
+    _record(_name(state));
+}
+
+static StateErrorType _onPing(State* state, StateEventType event)
+{
+    _record("!");
+    _record(_name(state));
+    return STATE_ERROR_NONE;
+}
+
+static StateErrorType _onPingDecline(State* state, StateEventType event)
+{
+    _record("?");
+    _record(_name(state));
+    return STATE_ERROR_FALSE;
+}
+
+static const StateEventFunc _rootEvents[] TINKER_PROGMEM = {
+    [_EVENT_PING] = _onPing,
+};
+
+static const StateEventFunc _a1Events[] TINKER_PROGMEM = {
+    [_EVENT_PING] = _onPingDecline,
+};
+
+TINKER_STATE(Root, 0, _onEnter, _onExit, _onLoop, TINKER_EVENTS(_rootEvents), TINKER_ANY_POWER, "Root");
+TINKER_STATE(A, &Root, _onEnter, _onExit, 0, TINKER_NO_EVENTS, TINKER_POWER(2, 0x01), "A");
+TINKER_STATE(A1, &A, _onEnter, _onExit, _onLoop, TINKER_EVENTS(_a1Events), TINKER_POWER(1, 0x02), "A1");
+TINKER_STATE(A2, &A, _onEnter, _onExit, 0, TINKER_NO_EVENTS, TINKER_ANY_POWER, "A2");
+TINKER_STATE(B, &Root, _onEnter, _onExit, _onLoop, TINKER_NO_EVENTS, TINKER_ANY_POWER, "B");
+TINKER_STATE(B1, &B, _onEnter, _onExit, 0, TINKER_NO_EVENTS, TINKER_ANY_POWER, "B1");
+
+static State* const _states[] = { &Root, &A, &A1, &A2, &B, &B1 };
+#define _STATE_COUNT (sizeof(_states) / sizeof(_states[0]))
+
+static const char* _name(State* state)
+{
+    return (const char*)StateGetUserData(state);
+}
+
+/**
+ * What leaving row for column has to exit and enter, worked out by hand from
+ * the tree above.
+ */
+static const char* const _transitions[_STATE_COUNT][_STATE_COUNT] = {
+    /* Root */ { "", "+A", "+A+A1", "+A+A2", "+B", "+B+B1" },
+    /* A    */ { "-A", "", "+A1", "+A2", "-A+B", "-A+B+B1" },
+    /* A1   */ { "-A1-A", "-A1", "", "-A1+A2", "-A1-A+B", "-A1-A+B+B1" },
+    /* A2   */ { "-A2-A", "-A2", "-A2+A1", "", "-A2-A+B", "-A2-A+B+B1" },
+    /* B    */ { "-B", "-B+A", "-B+A+A1", "-B+A+A2", "", "+B1" },
+    /* B1   */ { "-B1-B", "-B1-B+A", "-B1-B+A+A1", "-B1-B+A+A2", "-B1", "" },
+};
+
+static Machine _machine;
+static State* _changedFrom;
+static State* _changedTo;
+
+static void _onStateChange(Machine* machine, State* oldState, State* newState)
+{
+    _changedFrom = oldState;
+    _changedTo = newState;
+}
+
+static void _reset(State* focus)
+{
+    for (uint8_t i = 0; i < _STATE_COUNT; ++i)
+    {
+        _states[i]->_isEntered = 0;
+    }
+    CHECK(&_machine == MachineInit(&_machine, _onStateChange, _states, _STATE_COUNT));
+    _refuseEnter = 0;
+    if (focus)
+    {
+        SetMachineState(&_machine, focus);
+    }
+    _log[0] = 0;
+}
+
+static void _testEveryTransition(void)
+{
+    for (uint8_t from = 0; from < _STATE_COUNT; ++from)
+    {
+        for (uint8_t to = 0; to < _STATE_COUNT; ++to)
+        {
+            _reset(_states[from]);
+            CHECK(STATE_ERROR_NONE == SetMachineState(&_machine, _states[to]));
+            if (strcmp(_transitions[from][to], _log))
+            {
+                fprintf(stderr, "%s -> %s: expected \"%s\" got \"%s\"\n", _name(_states[from]), _name(_states[to]), _transitions[from][to], _log);
+                CHECK(!"transition");
+            }
+            CHECK(_states[to] == GetMachineFocus(&_machine));
+            for (State* state = _states[to]; state; state = GetParentState(state))
+            {
+                CHECK(StateIsEntered(state));
+            }
+        }
+    }
+}
+
+static void _testFirstTransitionEntersFromTheRoot(void)
+{
+    _reset(0);
+    CHECK(0 == GetMachineFocus(&_machine));
+    SetMachineState(&_machine, &A1);
+    CHECK(0 == strcmp("+Root+A+A1", _log));
+    CHECK(0 == _changedFrom && &A1 == _changedTo);
+}
+
+static void _testRefusedEntryKeepsFocus(void)
+{
+    _reset(&A1);
+    _refuseEnter = 1;
+    CHECK(STATE_ERROR_INVALID == SetMachineState(&_machine, &A2));
+    CHECK(&A1 == GetMachineFocus(&_machine));
+    CHECK(!StateIsEntered(&A2));
+}
+
+static void _testPendingTransitions(void)
+{
+    _reset(&A1);
+    _changedTo = 0;
+    CHECK(!HasPendingMachineTransitions(&_machine));
+
+    // Asking for where we already are queues nothing.
+    RequestMachineState(&_machine, &A1);
+    CHECK(!HasPendingMachineTransitions(&_machine));
+
+    // Nothing happens until the transitions are run, then they run in order.
+    RequestMachineState(&_machine, &B1);
+    RequestMachineState(&_machine, &A2);
+    CHECK(HasPendingMachineTransitions(&_machine));
+    CHECK(0 == _log[0] && 0 == _changedTo);
+    RunMachineTransitions(&_machine);
+    CHECK(!HasPendingMachineTransitions(&_machine));
+    CHECK(0 == strcmp("-A1-A+B+B1-B1-B+A+A2", _log));
+    CHECK(&A2 == GetMachineFocus(&_machine));
+
+    // A full queue replaces its last entry, repeats of the last are folded.
+    _log[0] = 0;
+    RequestMachineState(&_machine, &B);
+    RequestMachineState(&_machine, &A1);
+    RequestMachineState(&_machine, &A1);
+    RequestMachineState(&_machine, &B1);
+    RunMachineTransitions(&_machine);
+    CHECK(0 == strcmp("-A2-A+B+B1", _log));
+
+    // Data goes to the transition that asked for it.
+    static uint8_t payload;
+    CHECK(STATE_ERROR_INVALID == RequestMachineStateWData(&_machine, 0, &payload, 1));
+    CHECK(STATE_ERROR_NONE == RequestMachineStateWData(&_machine, &A, &payload, sizeof(payload)));
+    CHECK(&payload == _machine._pending[0].data && sizeof(payload) == _machine._pending[0].dataLen);
+    RunMachineTransitions(&_machine);
+    CHECK(&A == GetMachineFocus(&_machine));
+}
+
+static void _testEventsBubble(void)
+{
+    _reset(&A1);
+    // A1 declines, A has no table, Root handles it.
+    CHECK(STATE_ERROR_NONE == DispatchMachineEvent(&_machine, _EVENT_PING));
+    CHECK(0 == strcmp("?A1!Root", _log));
+    // Past the end of every table.
+    CHECK(STATE_ERROR_FALSE == DispatchMachineEvent(&_machine, _EVENT_PONG));
+}
+
+static void _testLoopFunctionsChildFirst(void)
+{
+    _reset(&A1);
+    MachineLoop(&_machine);
+    CHECK(0 == strcmp("@A1@Root", _log));
+    _reset(&B1);
+    MachineLoop(&_machine);
+    CHECK(0 == strcmp("@B@Root", _log));
+}
+
+static void _testPowerCombinesAncestors(void)
+{
+    _reset(&A1);
+    StatePower power = GetMachinePower(&_machine);
+    CHECK(1 == power.deepestSleep && 0x03 == power.peripherals);
+    SetMachineState(&_machine, &A2);
+    power = GetMachinePower(&_machine);
+    CHECK(2 == power.deepestSleep && 0x01 == power.peripherals);
+    SetMachineState(&_machine, &B1);
+    power = GetMachinePower(&_machine);
+    CHECK(STATE_SLEEP_DEEPEST == power.deepestSleep && 0 == power.peripherals);
+}
+
+int main(void)
+{
+    _testEveryTransition();
+    _testFirstTransitionEntersFromTheRoot();
+    _testRefusedEntryKeepsFocus();
+    _testPendingTransitions();
+    _testEventsBubble();
+    _testLoopFunctionsChildFirst();
+    _testPowerCombinesAncestors();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,110 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Unit tests for PulseTrain: quantizing edges into the symbol dictionary,
+ * nibble packing and the limits on edges and symbols.
+ */
+
+#include "Check.h"
+#include "Pulse.h"
+
+static PulseTrain _train;
+
+static void _testQuantizesToSymbols(void)
+{
+    PulseTrainInit(&_train);
+    // An NEC style header and a couple of bits with receiver jitter.
+    const uint16_t units[] = { 450, 225, 28, 28, 30, 84, 27, 82, 29 };
+    for (uint8_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i)
+    {
+        CHECK(PULSETRAIN_OK == AppendPulseTrainEdge(&_train, units[i]));
+    }
+    CHECK(9 == _train.edgeCount);
+    CHECK(4 == _train.symbolCount);
+    // Edges read back as the first duration of their symbol.
+    CHECK(450 == GetPulseTrainEdge(&_train, 0));
+    CHECK(225 == GetPulseTrainEdge(&_train, 1));
+    CHECK(28 == GetPulseTrainEdge(&_train, 4));
+    CHECK(84 == GetPulseTrainEdge(&_train, 5));
+    CHECK(28 == GetPulseTrainEdge(&_train, 6));
+    CHECK(84 == GetPulseTrainEdge(&_train, 7));
+    CHECK(28 == GetPulseTrainEdge(&_train, 8));
+    CHECK(0 == GetPulseTrainEdge(&_train, 9));
+}
+
+static void _testClosestSymbolWins(void)
+{
+    PulseTrainInit(&_train);
+    AppendPulseTrainEdge(&_train, 100);
+    AppendPulseTrainEdge(&_train, 140);
+    // Within tolerance of both but closer to the second.
+    AppendPulseTrainEdge(&_train, 125);
+    CHECK(2 == _train.symbolCount);
+    CHECK(140 == GetPulseTrainEdge(&_train, 2));
+}
+
+static void _testShortDurationsUseMinimumTolerance(void)
+{
+    PulseTrainInit(&_train);
+    AppendPulseTrainEdge(&_train, 8);
+    AppendPulseTrainEdge(&_train, 8 + PULSETRAIN_MIN_TOLERANCE);
+    AppendPulseTrainEdge(&_train, 8 + PULSETRAIN_MIN_TOLERANCE * 2 + 1);
+    CHECK(2 == _train.symbolCount);
+    CHECK(8 == GetPulseTrainEdge(&_train, 1));
+}
+
+static void _testEdgeMatch(void)
+{
+    PulseTrainInit(&_train);
+    AppendPulseTrainEdge(&_train, 400);
+    CHECK(IsPulseTrainEdgeMatch(&_train, 0, 400));
+    CHECK(IsPulseTrainEdgeMatch(&_train, 0, 400 + (400 >> PULSETRAIN_TOLERANCE_SHIFT)));
+    CHECK(!IsPulseTrainEdgeMatch(&_train, 0, 600));
+    CHECK(!IsPulseTrainEdgeMatch(&_train, 1, 400));
+    // Matching doesn't append.
+    CHECK(1 == _train.edgeCount);
+}
+
+static void _testSymbolsRunOut(void)
+{
+    PulseTrainInit(&_train);
+    uint16_t units = 10;
+    for (uint8_t i = 0; i < PULSETRAIN_MAX_SYMBOLS; ++i)
+    {
+        CHECK(PULSETRAIN_OK == AppendPulseTrainEdge(&_train, units));
+        units *= 2;
+        units -= units >> 2;
+    }
+    CHECK(PULSETRAIN_MAX_SYMBOLS == _train.symbolCount);
+    CHECK(PULSETRAIN_NO_SYMBOLS == AppendPulseTrainEdge(&_train, 1));
+    // Existing symbols still fit.
+    CHECK(PULSETRAIN_OK == AppendPulseTrainEdge(&_train, 10));
+}
+
+static void _testTrainFills(void)
+{
+    PulseTrainInit(&_train);
+    for (uint16_t i = 0; i < PULSETRAIN_MAX_EDGES; ++i)
+    {
+        // Alternate so both nibbles of every byte are written.
+        CHECK(PULSETRAIN_OK == AppendPulseTrainEdge(&_train, (i & 1) ? 100 : 50));
+    }
+    CHECK(PULSETRAIN_FULL == AppendPulseTrainEdge(&_train, 50));
+    CHECK(PULSETRAIN_MAX_EDGES == _train.edgeCount);
+    CHECK(50 == GetPulseTrainEdge(&_train, PULSETRAIN_MAX_EDGES - 2));
+    CHECK(100 == GetPulseTrainEdge(&_train, PULSETRAIN_MAX_EDGES - 1));
+}
+
+int main(void)
+{
+    _testQuantizesToSymbols();
+    _testClosestSymbolWins();
+    _testShortDurationsUseMinimumTolerance();
+    _testEdgeMatch();
+    _testSymbolsRunOut();
+    _testTrainFills();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,74 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+
+#include "TestClock.h"
+
+static struct
+{
+    RunLoop runLoop;
+    TimerService* service;
+    OnTestClockTickFunc onTick;
+    uint32_t now;
+    uint32_t lastSync;
+    uint32_t deadline;
+    uint16_t armedMillis;
+    uint8_t isArmed;
+} _clock;
+
+static uint16_t _elapsed(void)
+{
+    const uint32_t elapsed = _clock.now - _clock.lastSync;
+    _clock.lastSync = _clock.now;
+    return (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+}
+
+static void _arm(uint16_t millis)
+{
+    _clock.armedMillis = millis;
+    _clock.isArmed = (millis != 0);
+    _clock.deadline = _clock.now + millis;
+}
+
+RunLoop* TestClockInit(TimerService* service, OnTestClockTickFunc onTick)
+{
+    _clock.now = 0;
+    _clock.lastSync = 0;
+    _clock.isArmed = 0;
+    _clock.armedMillis = 0;
+    _clock.onTick = onTick;
+    _clock.service = service;
+    InitRunLoop(&_clock.runLoop);
+    TimerServiceInit(service, &_clock.runLoop, _elapsed, _arm);
+    return &_clock.runLoop;
+}
+
+void TestClockAdvance(uint32_t millis)
+{
+    while (millis--)
+    {
+        ++_clock.now;
+        if (_clock.onTick)
+        {
+            _clock.onTick(_clock.now);
+        }
+        if (_clock.isArmed && _clock.now >= _clock.deadline)
+        {
+            _clock.isArmed = 0;
+            TimerServiceAlarm(_clock.service);
+        }
+        DrainRunLoop(&_clock.runLoop);
+    }
+}
+
+uint32_t TestClockNow(void)
+{
+    return _clock.now;
+}
+
+uint16_t TestClockArmedMillis(void)
+{
+    return _clock.isArmed ? _clock.armedMillis : 0;
+}
@@ -0,0 +1,47 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * \file TestClock.h
+ * A millisecond clock standing in for Timer0 so TimerService can be driven
+ * from a test. The alarm is raised from TestClockAdvance the way the timer
+ * interrupt would and the runloop is drained after every millisecond.
+ */
+
+#ifndef TESTCLOCK_H_
+#define TESTCLOCK_H_
+
+#include "tinker/Timer.h"
+#include <stdint.h>
+
+/**
+ * Called once per simulated millisecond before the alarm is checked. Use it
+ * to feed a ButtonGroup its sample. May be 0.
+ */
+typedef void (*OnTestClockTickFunc)(uint32_t now);
+
+/**
+ * Reset the clock to 0 and set up service on its own runloop.
+ * \return The runloop the service posts to. Add other ports to it as needed.
+ */
+RunLoop* TestClockInit(TimerService* service, OnTestClockTickFunc onTick);
+
+/**
+ * Run the clock forward a millisecond at a time.
+ */
+void TestClockAdvance(uint32_t millis);
+
+/**
+ * \return Milliseconds since TestClockInit.
+ */
+uint32_t TestClockNow(void);
+
+/**
+ * \return The milliseconds the service last armed the source for (0 for
+ *         disarmed).
+ */
+uint16_t TestClockArmedMillis(void);
+
+#endif /* TESTCLOCK_H_ */
@@ -0,0 +1,137 @@
+/*
+~          +-+
+~ IR THING |  ) ... ... ..     ... ... ..     ... ... ..     ... ... ..
+~          +-+
+*/
+/**
+ * Unit tests for TimerService: ordering of the delta list, periodic timers,
+ * cancelling and rescheduling, remaining time and how the source is armed.
+ */
+
+#include "Check.h"
+#include "TestClock.h"
+#include <string.h>
+
+#define _TIMERS 3
+
+static TimerService _service;
+static Timer _timers[_TIMERS];
+static uint32_t _firedAt[_TIMERS];
+static uint8_t _fireCount[_TIMERS];
+static char _order[16];
+static uint8_t _orderCount;
+
+static void _onTimer(Timer* timer)
+{
+    const uint8_t index = (uint8_t)(timer - _timers);
+    _firedAt[index] = TestClockNow();
+    ++_fireCount[index];
+    if (_orderCount + 1 < sizeof(_order))
+    {
+        _order[_orderCount++] = 'a' + index;
+        _order[_orderCount] = 0;
+    }
+}
+
+static void _reset(void)
+{
+    TestClockInit(&_service, 0);
+    for (uint8_t i = 0; i < _TIMERS; ++i)
+    {
+        TimerInit(&_timers[i], _onTimer);
+        _firedAt[i] = 0;
+        _fireCount[i] = 0;
+    }
+    _order[0] = 0;
+    _orderCount = 0;
+}
+
+static void _testFiresInDeadlineOrder(void)
+{
+    _reset();
+    ScheduleTimer(&_service, &_timers[0], 30, 0);
+    ScheduleTimer(&_service, &_timers[1], 10, 0);
+    ScheduleTimer(&_service, &_timers[2], 20, 0);
+    CHECK(10 == TestClockArmedMillis());
+    TestClockAdvance(50);
+    CHECK(30 == _firedAt[0] && 10 == _firedAt[1] && 20 == _firedAt[2]);
+    CHECK(0 == strcmp("bca", _order));
+    CHECK(!HasScheduledTimers(&_service));
+    CHECK(0 == TestClockArmedMillis());
+}
+
+static void _testEqualDeadlinesKeepScheduleOrder(void)
+{
+    _reset();
+    ScheduleTimer(&_service, &_timers[2], 15, 0);
+    ScheduleTimer(&_service, &_timers[0], 15, 0);
+    TestClockAdvance(15);
+    CHECK(0 == strcmp("ca", _order));
+}
+
+static void _testScheduledWhileRunning(void)
+{
+    _reset();
+    ScheduleTimer(&_service, &_timers[0], 100, 0);
+    TestClockAdvance(40);
+    // Deadlines are relative to when each timer was scheduled.
+    ScheduleTimer(&_service, &_timers[1], 20, 0);
+    CHECK(60 == GetTimerRemaining(&_service, &_timers[0]));
+    CHECK(20 == GetTimerRemaining(&_service, &_timers[1]));
+    TestClockAdvance(100);
+    CHECK(100 == _firedAt[0] && 60 == _firedAt[1]);
+}
+
+static void _testPeriodic(void)
+{
+    _reset();
+    ScheduleTimer(&_service, &_timers[0], 5, 10);
+    TestClockAdvance(36);
+    CHECK(4 == _fireCount[0] && 35 == _firedAt[0]);
+    CHECK(IsTimerScheduled(&_timers[0]));
+    CHECK(9 == GetTimerRemaining(&_service, &_timers[0]));
+    CancelTimer(&_service, &_timers[0]);
+    TestClockAdvance(50);
+    CHECK(4 == _fireCount[0]);
+    CHECK(!IsTimerScheduled(&_timers[0]));
+}
+
+static void _testCancelAndReschedule(void)
+{
+    _reset();
+    ScheduleTimer(&_service, &_timers[0], 10, 0);
+    ScheduleTimer(&_service, &_timers[1], 20, 0);
+    ScheduleTimer(&_service, &_timers[2], 30, 0);
+    // Removing from the middle of the list mustn't move the later deadline.
+    CancelTimer(&_service, &_timers[1]);
+    CHECK(30 == GetTimerRemaining(&_service, &_timers[2]));
+    // Rescheduling replaces the old deadline.
+    ScheduleTimer(&_service, &_timers[0], 40, 0);
+    CHECK(30 == TestClockArmedMillis());
+    TestClockAdvance(50);
+    CHECK(1 == _fireCount[0] && 40 == _firedAt[0]);
+    CHECK(0 == _fireCount[1]);
+    CHECK(1 == _fireCount[2] && 30 == _firedAt[2]);
+    CHECK(0 == GetTimerRemaining(&_service, &_timers[1]));
+}
+
+static void _testZeroDelayWaitsForTheAlarm(void)
+{
+    _reset();
+    ScheduleTimer(&_service, &_timers[0], 0, 0);
+    CHECK(0 == _fireCount[0]);
+    CHECK(1 == TestClockArmedMillis());
+    TestClockAdvance(1);
+    CHECK(1 == _fireCount[0]);
+}
+
+int main(void)
+{
+    _testFiresInDeadlineOrder();
+    _testEqualDeadlinesKeepScheduleOrder();
+    _testScheduledWhileRunning();
+    _testPeriodic();
+    _testCancelAndReschedule();
+    _testZeroDelayWaitsForTheAlarm();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,128 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "tinker/ButtonGroup.h"
+
+static void _buttonsChanged(ButtonGroup* self, uint8_t changed)
+{
+    const uint8_t pressed = self->_pressed;
+    const uint8_t down = changed & pressed;
+    const uint8_t up = changed & ~pressed;
+    if (down)
+    {
+        self->_longPressButtons = down;
+        self->_heldSamples = 0;
+        self->_secondPressButtons = (self->_releasedSamples < BUTTON_GROUP_SAMPLES_IS_DOUBLECLICK) ? (down & self->_clickedButtons) : 0;
+        self->_onButtonEvent(self, BUTTON_EVENT_DOWN, down);
+    }
+    if (up)
+    {
+        const uint8_t doubleClicked = up & self->_secondPressButtons;
+        self->_longPressButtons &= ~up;
+        self->_secondPressButtons &= ~up;
+        // A double click doesn't start another one.
+        self->_clickedButtons = up & ~doubleClicked;
+        self->_releasedSamples = 0;
+        self->_onButtonEvent(self, BUTTON_EVENT_UP, up);
+        if (doubleClicked)
+        {
+            self->_onButtonEvent(self, BUTTON_EVENT_DOUBLE_CLICK, doubleClicked);
+        }
+    }
+}
+
+void ButtonGroupSample(ButtonGroup* self, uint8_t sample)
+{
+    // Set for each button whose reading disagrees with its debounced state.
+    const uint8_t delta = (((sample ^ self->_activeLow) & self->_mask) ^ self->_pressed);
+
+    // Count disagreeing samples in parallel. Agreeing ones clear their
+    // counter. The eighth in a row flips the button and wraps its counter.
+    const uint8_t count0 = self->_count0;
+    const uint8_t count1 = self->_count1;
+    const uint8_t changed = delta & count0 & count1 & self->_count2;
+    self->_count2 = (self->_count2 ^ (count1 & count0)) & delta;
+    self->_count1 = (count1 ^ count0) & delta;
+    self->_count0 = ~count0 & delta;
+
+    if (changed)
+    {
+        self->_pressed ^= changed;
+        _buttonsChanged(self, changed);
+    }
+
+    if (self->_longPressButtons && ++(self->_heldSamples) == BUTTON_GROUP_SAMPLES_IS_LONGPRESS)
+    {
+        const uint8_t held = self->_longPressButtons;
+        self->_longPressButtons = 0;
+        self->_onButtonEvent(self, BUTTON_EVENT_LONG_PRESS, held);
+    }
+
+    // Don't let this wrap around and allow a very late double click.
+    if (self->_releasedSamples < BUTTON_GROUP_SAMPLES_IS_DOUBLECLICK)
+    {
+        ++(self->_releasedSamples);
+    }
+}
+
+static uint8_t _HandlePortMessage(RunLoopPort* port, RunLoop* runLoop, RunLoopMessageType messageType, RunLoopMessageData data)
+{
+    if (RUNLOOP_MESSAGE_BUTTONGROUPSAMPLE == messageType)
+    {
+        ButtonGroupSample((ButtonGroup*)port->userData, (0xFF & data));
+        return 1;
+    }
+    return 0;
+}
+
+ButtonGroup* ButtonGroupInit(ButtonGroup* group, uint8_t mask, uint8_t activeLow, OnButtonGroupEventFunc handler, RunLoop* runLoop)
+{
+    if (group)
+    {
+        if (RUNLOOP_MAX_PORTS == AddPort(runLoop, &group->_port))
+        {
+            group = 0;
+        }
+        else
+        {
+            group->_count0 = 0;
+            group->_count1 = 0;
+            group->_count2 = 0;
+            group->_pressed = 0;
+            group->_mask = mask;
+            group->_activeLow = activeLow & mask;
+            group->_longPressButtons = 0;
+            group->_heldSamples = 0;
+            group->_clickedButtons = 0;
+            group->_secondPressButtons = 0;
+            group->_releasedSamples = BUTTON_GROUP_SAMPLES_IS_DOUBLECLICK;
+            group->_onButtonEvent = handler;
+            InitRunLoopPort(&group->_port, _HandlePortMessage);
+            group->_port.userData = group;
+        }
+    }
+    return group;
+}
+
+uint8_t GetButtonGroupPressed(ButtonGroup* group)
+{
+    return (group) ? group->_pressed : 0;
+}
+
+bool IsButtonGroupSettled(ButtonGroup* group)
+{
+    return (group && !(group->_count0 | group->_count1 | group->_count2));
+}
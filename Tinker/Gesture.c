@@ -0,0 +1,118 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "tinker/Gesture.h"
+
+/**
+ * Idle       --down-->  Pressed   (timer: hold)
+ * Pressed    --up---->  Released  (timer: multi-click window)
+ * Pressed    --timer->  Held      (timer: repeat, periodic)
+ * Released   --down-->  Pressed   (timer: hold)
+ * Released   --timer->  Idle
+ * Held       --up---->  Idle
+ */
+#define GESTURE_STATE_IDLE      0
+#define GESTURE_STATE_PRESSED   1
+#define GESTURE_STATE_RELEASED  2
+#define GESTURE_STATE_HELD      3
+
+static void _onGestureTimer(Timer* timer)
+{
+    Gesture* self = (Gesture*)timer->userData;
+    switch(self->_state)
+    {
+        case GESTURE_STATE_PRESSED:
+        {
+            const uint8_t clicks = self->_count;
+            self->_state = GESTURE_STATE_HELD;
+            self->_count = 0;
+            if (self->_repeatMillis)
+            {
+                ScheduleTimer(self->_timerService, &self->_timer, self->_repeatMillis, self->_repeatMillis);
+            }
+            self->_onGestureEvent(self, GESTURE_EVENT_HOLD, clicks);
+        }
+        break;
+        case GESTURE_STATE_HELD:
+        {
+            // Saturate rather than wrap back to the shortest class.
+            if (self->_count < 0xFF)
+            {
+                ++(self->_count);
+            }
+            self->_onGestureEvent(self, GESTURE_EVENT_HOLD_REPEAT, self->_count);
+        }
+        break;
+        case GESTURE_STATE_RELEASED:
+        {
+            self->_state = GESTURE_STATE_IDLE;
+            self->_onGestureEvent(self, GESTURE_EVENT_CLICKS_DONE, self->_count);
+        }
+        break;
+    }
+}
+
+void GestureHandleButtonEvent(Gesture* gesture, ButtonEventType event)
+{
+    if (!gesture)
+    {
+        return;
+    }
+    if (BUTTON_EVENT_DOWN == event)
+    {
+        if (GESTURE_STATE_RELEASED != gesture->_state)
+        {
+            gesture->_count = 0;
+        }
+        gesture->_state = GESTURE_STATE_PRESSED;
+        ScheduleTimer(gesture->_timerService, &gesture->_timer, gesture->_holdMillis, 0);
+    }
+    else if (BUTTON_EVENT_UP == event)
+    {
+        if (GESTURE_STATE_PRESSED == gesture->_state)
+        {
+            if (gesture->_count < 0xFF)
+            {
+                ++(gesture->_count);
+            }
+            gesture->_state = GESTURE_STATE_RELEASED;
+            ScheduleTimer(gesture->_timerService, &gesture->_timer, GESTURE_MULTICLICK_MILLIS, 0);
+            gesture->_onGestureEvent(gesture, GESTURE_EVENT_CLICK, gesture->_count);
+        }
+        else if (GESTURE_STATE_HELD == gesture->_state)
+        {
+            gesture->_state = GESTURE_STATE_IDLE;
+            CancelTimer(gesture->_timerService, &gesture->_timer);
+            gesture->_onGestureEvent(gesture, GESTURE_EVENT_HOLD_RELEASE, gesture->_count);
+        }
+    }
+}
+
+Gesture* GestureInit(Gesture* gesture, OnGestureEventFunc handler, TimerService* timerService, uint16_t holdMillis, uint16_t repeatMillis)
+{
+    if (gesture)
+    {
+        gesture->_state = GESTURE_STATE_IDLE;
+        gesture->_count = 0;
+        gesture->_holdMillis = holdMillis;
+        gesture->_repeatMillis = repeatMillis;
+        gesture->_onGestureEvent = handler;
+        gesture->_timerService = timerService;
+        TimerInit(&gesture->_timer, _onGestureTimer);
+        gesture->_timer.userData = gesture;
+    }
+    return gesture;
+}
@@ -0,0 +1,286 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * \file Machine.c
+ * Implementation of Machine.h. The focus, its caches and the pending queue
+ * only change in critical sections (see Platform.h) so interrupts never see
+ * them half written. State callbacks run outside of them.
+ */
+#include "tinker/Machine.h"
+
+// +--------------------------------------------------------------------------+
+// | MACHINE->STATE INTERNAL INTERFACE
+// +--------------------------------------------------------------------------+
+extern StateErrorType StateEnter(State* state, void* data, uint8_t datalen);
+extern StateErrorType StateExit(State* state, void* data, uint8_t datalen);
+extern StateFunc GetStateLoopFunc(State* state);
+extern StatePower GetStatePower(State* state);
+
+// +--------------------------------------------------------------------------+
+// | LEAST COMMON ANCESTORS
+// +--------------------------------------------------------------------------+
+static inline uint8_t* _lcaEntry(Machine* machine, uint8_t a, uint8_t b)
+{
+    return (a >= b) ? &machine->_lca[((a * (a + 1)) >> 1) + b] : &machine->_lca[((b * (b + 1)) >> 1) + a];
+}
+
+/**
+ * Only run at init so a simple quadratic walk is fine.
+ */
+static uint8_t _findLeastCommonAncestor(State* a, State* b)
+{
+    for (State* ancestor = a; ancestor; ancestor = GetParentState(ancestor))
+    {
+        for (State* other = b; other; other = GetParentState(other))
+        {
+            if (ancestor == other)
+            {
+                return ancestor->_index;
+            }
+        }
+    }
+    return STATE_INDEX_NONE;
+}
+
+// +--------------------------------------------------------------------------+
+// | LOOP FUNCTIONS
+// +--------------------------------------------------------------------------+
+/**
+ * \return The number of loop functions from state up to the root, or more
+ *         than MACHINE_MAX_LOOP_FUNCS if they don't fit.
+ */
+static uint8_t _cacheLoopFuncs(Machine* machine, State* state)
+{
+    uint8_t count = 0;
+    for (; state; state = GetParentState(state))
+    {
+        const StateFunc onLoop = GetStateLoopFunc(state);
+        if (onLoop)
+        {
+            if (count < MACHINE_MAX_LOOP_FUNCS)
+            {
+                machine->_loopFuncs[count] = onLoop;
+                machine->_loopStates[count] = state;
+            }
+            ++count;
+        }
+    }
+    machine->_loopFuncCount = (count > MACHINE_MAX_LOOP_FUNCS) ? MACHINE_MAX_LOOP_FUNCS : count;
+    return count;
+}
+
+// +--------------------------------------------------------------------------+
+// | POWER
+// +--------------------------------------------------------------------------+
+static void _cachePower(Machine* machine, State* state)
+{
+    StatePower power = { STATE_SLEEP_DEEPEST, 0 };
+    for (; state; state = GetParentState(state))
+    {
+        const StatePower statePower = GetStatePower(state);
+        if (statePower.deepestSleep < power.deepestSleep)
+        {
+            power.deepestSleep = statePower.deepestSleep;
+        }
+        power.peripherals |= statePower.peripherals;
+    }
+    machine->_power = power;
+}
+
+// +--------------------------------------------------------------------------+
+// | MACHINE
+// +--------------------------------------------------------------------------+
+Machine* MachineInit(Machine* machine, OnStateChangeFunc stateChangeHandler, State* const states[], uint8_t stateCount)
+{
+    if (!machine || stateCount > MACHINE_MAX_STATES)
+    {
+        return 0;
+    }
+    machine->_focus = 0;
+    machine->_stateChangeHandler = stateChangeHandler;
+    machine->_stateCount = stateCount;
+    for (uint8_t i = 0; i < stateCount; ++i)
+    {
+        states[i]->_index = i;
+    }
+    for (uint8_t i = 0; i < stateCount; ++i)
+    {
+        if (_cacheLoopFuncs(machine, states[i]) > MACHINE_MAX_LOOP_FUNCS)
+        {
+            return 0;
+        }
+        for (uint8_t j = 0; j <= i; ++j)
+        {
+            *_lcaEntry(machine, i, j) = _findLeastCommonAncestor(states[i], states[j]);
+        }
+    }
+    machine->_loopFuncCount = 0;
+    _cachePower(machine, 0);
+    machine->_pendingCount = 0;
+    return machine;
+}
+
+void MachineLoop(Machine* machine)
+{
+    State* const focus = machine->_focus;
+    // A loop function that changes state ends the pass; the next one runs
+    // the new focus's functions.
+    for (uint8_t i = 0; i < machine->_loopFuncCount && focus == machine->_focus; ++i)
+    {
+        machine->_loopFuncs[i](machine->_loopStates[i]);
+    }
+}
+
+StateErrorType RequestMachineState(Machine* machine, State* state)
+{
+    return RequestMachineStateWData(machine, state, 0, 0);
+}
+
+StateErrorType RequestMachineStateWData(Machine* machine, State* state, void* data, uint8_t dataLen)
+{
+    if (!machine || !state || state->_index >= machine->_stateCount)
+    {
+        return STATE_ERROR_INVALID;
+    }
+
+    const TinkerCriticalState critical = TinkerEnterCritical();
+    uint8_t count = machine->_pendingCount;
+    MachineTransition* last = (count) ? &machine->_pending[count - 1] : 0;
+    if (!last && state == machine->_focus)
+    {
+        // Already there and nothing queued would move us away.
+    }
+    else
+    {
+        if (!last || (last->state != state && count < MACHINE_MAX_PENDING_TRANSITIONS))
+        {
+            last = &machine->_pending[count++];
+        }
+        last->state = state;
+        last->data = data;
+        last->dataLen = dataLen;
+        machine->_pendingCount = count;
+    }
+    TinkerExitCritical(critical);
+    return STATE_ERROR_NONE;
+}
+
+void RunMachineTransitions(Machine* machine)
+{
+    while (machine->_pendingCount)
+    {
+        const TinkerCriticalState critical = TinkerEnterCritical();
+        const MachineTransition next = machine->_pending[0];
+        const uint8_t count = --machine->_pendingCount;
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            machine->_pending[i] = machine->_pending[i + 1];
+        }
+        TinkerExitCritical(critical);
+        SetMachineStateWData(machine, next.state, next.data, next.dataLen);
+    }
+}
+
+bool HasPendingMachineTransitions(Machine* machine)
+{
+    return (machine && machine->_pendingCount);
+}
+
+StateErrorType DispatchMachineEvent(Machine* machine, StateEventType event)
+{
+    for (State* state = (machine) ? machine->_focus : 0; state; state = GetParentState(state))
+    {
+        const StateErrorType result = StateHandleEvent(state, event);
+        if (STATE_ERROR_FALSE != result)
+        {
+            return result;
+        }
+    }
+    return STATE_ERROR_FALSE;
+}
+
+StatePower GetMachinePower(Machine* machine)
+{
+    const StatePower none = { STATE_SLEEP_DEEPEST, 0 };
+    return (machine) ? machine->_power : none;
+}
+
+State* GetMachineFocus(Machine* machine)
+{
+    return (machine) ? machine->_focus : 0;
+}
+
+StateErrorType SetMachineState(Machine* machine, State* state)
+{
+    return SetMachineStateWData(machine, state, 0, 0);
+}
+
+StateErrorType SetMachineStateWData(Machine* machine, State* state, void* data, uint8_t dataLen)
+{
+    if (!machine || !state || state->_index >= machine->_stateCount)
+    {
+        return STATE_ERROR_INVALID;
+    }
+
+    // Interrupts are only masked while the focus and its caches change. The
+    // enter, exit and state change callbacks run with them as they were.
+    StateErrorType result = STATE_ERROR_NONE;
+    State* oldState = machine->_focus;
+    if (oldState != state)
+    {
+        const uint8_t lcaIndex = (oldState) ? *_lcaEntry(machine, oldState->_index, state->_index) : STATE_INDEX_NONE;
+
+        // Exit up from the old focus, children first, stopping below the
+        // common ancestor.
+        State* exiting = oldState;
+        while (exiting && exiting->_index != lcaIndex && STATE_ERROR_NONE == result)
+        {
+            result = StateExit(exiting, 0, 0);
+            exiting = GetParentState(exiting);
+        }
+
+        if (STATE_ERROR_NONE == result)
+        {
+            // Collect the entry path below the common ancestor then enter it
+            // top down.
+            State* entryPath[MACHINE_MAX_STATES];
+            uint8_t depth = 0;
+            for (State* entering = state; entering && entering->_index != lcaIndex; entering = GetParentState(entering))
+            {
+                entryPath[depth++] = entering;
+            }
+            while (depth && STATE_ERROR_NONE == result)
+            {
+                result = StateEnter(entryPath[--depth], data, dataLen);
+            }
+        }
+
+        if (STATE_ERROR_NONE == result)
+        {
+            const TinkerCriticalState critical = TinkerEnterCritical();
+            machine->_focus = state;
+            _cacheLoopFuncs(machine, state);
+            _cachePower(machine, state);
+            TinkerExitCritical(critical);
+            if (machine->_stateChangeHandler)
+            {
+                machine->_stateChangeHandler(machine, oldState, state);
+            }
+        }
+    }
+    return result;
+}
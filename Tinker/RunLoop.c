@@ -18,6 +18,11 @@ limitations under the License.
 #include "tinker/RunLoop.h"
 #include <string.h>
 
+#define _RUNLOOP_QUEUE_MASK (RUNLOOP_QUEUE_SIZE - 1)
+
+// Keeps the compiler from moving queue slot accesses across index updates.
+#define _RUNLOOP_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
 RunLoopPort* InitRunLoopPort(RunLoopPort* newPort, OnHandlePortMessageFunc handler)
 {
     if (newPort)
@@ -51,6 +56,8 @@ RunLoop* InitRunLoop(RunLoop* newLoop)
     {
         memset(newLoop->_ports, 0, sizeof(RunLoopPort*) * RUNLOOP_MAX_PORTS);
         newLoop->_portCount = 0;
+        newLoop->_queueHead = 0;
+        newLoop->_queueTail = 0;
         newLoop->runMode = _RunMode;
     }
     return newLoop;
@@ -93,4 +100,48 @@ RunLoopPort* RemovePort(RunLoop* runLoop, uint8_t portNumber)
         }
     }
     return removed;
-}
+}
+
+uint8_t PostRunLoopMessage(RunLoop* runLoop, RunLoopMessageType messageType, RunLoopMessageData messageData)
+{
+    uint8_t posted = 0;
+    if (runLoop)
+    {
+        const uint8_t head = runLoop->_queueHead;
+        const uint8_t next = (head + 1) & _RUNLOOP_QUEUE_MASK;
+        if (next != runLoop->_queueTail)
+        {
+            runLoop->_queue[head].type = messageType;
+            runLoop->_queue[head].data = messageData;
+            _RUNLOOP_BARRIER();
+            runLoop->_queueHead = next;
+            posted = 1;
+        }
+    }
+    return posted;
+}
+
+uint8_t DrainRunLoop(RunLoop* runLoop)
+{
+    uint8_t drained = 0;
+    if (runLoop)
+    {
+        uint8_t tail = runLoop->_queueTail;
+        while (tail != runLoop->_queueHead)
+        {
+            _RUNLOOP_BARRIER();
+            const RunLoopMessage message = runLoop->_queue[tail];
+            _RUNLOOP_BARRIER();
+            tail = (tail + 1) & _RUNLOOP_QUEUE_MASK;
+            runLoop->_queueTail = tail;
+            runLoop->runMode(runLoop, message.type, message.data);
+            ++drained;
+        }
+    }
+    return drained;
+}
+
+uint8_t HasRunLoopMessages(RunLoop* runLoop)
+{
+    return (runLoop && runLoop->_queueTail != runLoop->_queueHead);
+}
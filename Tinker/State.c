@@ -14,193 +14,96 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-#include "tinker/State.h"
-
-// +--------------------------------------------------------------------------+
-// | PRIVATE STATE TYPE
-// +--------------------------------------------------------------------------+
-typedef struct _StatePrivateType
-{
-    State* parent;
-    uint8_t isEntered;
-    StateFunc localOnLoop;
-    size_t childStateCount;
-    State* childStates[];
-} StatePrivate;
-
-StatePrivate* StatePrivateInitWSubstates(StatePrivate* newStatePrivate, State* parentState, StateFunc onLoop, State* substates[], size_t substateCount)
-{
-    if (newStatePrivate)
-    {
-        newStatePrivate->parent = parentState;
-        newStatePrivate->localOnLoop = onLoop;
-        newStatePrivate->isEntered = 0;
-        newStatePrivate->childStateCount = substateCount;
-        for(size_t i = 0; i < substateCount; ++i)
-        {
-            newStatePrivate->childStates[i] = substates[i];
-        }
-    }
-    return newStatePrivate;
-}
-
-StatePrivate* NewStatePrivate(size_t substateCount)
-{
-    static const size_t statePrivateSize = sizeof(StatePrivate);
-    StatePrivate* priv;
-    priv = malloc(statePrivateSize + (sizeof(State*) * substateCount));
-    return priv;
-}
-
-void StatePrivateDelete(StatePrivate* priv)
-{
-    free(priv);
-}
-
-void BubblingOnLoop(State* state)
-{
-    if (state)
-    {
-        StatePrivate* priv = (StatePrivate*)state->_storage;
-        if (priv->localOnLoop)
-        {
-            priv->localOnLoop(state);
-        }
-        BubblingOnLoop(priv->parent);
-    }
-}
-
-// +--------------------------------------------------------------------------+
-// | STATE METHOD IMPLEMENTATION
-// +--------------------------------------------------------------------------+
-State* StateInit(State* newState, State* parentState, StateTransitionFunc enter, StateTransitionFunc exit, StateFunc onLoop)
+#include "tinker/State.h"
+
+// +--------------------------------------------------------------------------+
+// | DESCRIPTOR ACCESS
+// +--------------------------------------------------------------------------+
+#define _DESCRIPTOR_FIELD(STATE, FIELD) TINKER_READ_PTR(&(STATE)->_descriptor->FIELD)
+
+// +--------------------------------------------------------------------------+
+// | STATE METHOD IMPLEMENTATION
+// +--------------------------------------------------------------------------+
+StateFunc GetStateLoopFunc(State* state)
 {
-    return StateInitWSubstates(newState, parentState, enter, exit, onLoop, 0, 0);
+    return (state) ? (StateFunc)_DESCRIPTOR_FIELD(state, onLoop) : 0;
 }
 
-State* StateInitWSubstates(State* newState, State* parentState, StateTransitionFunc enter, StateTransitionFunc exit, StateFunc onLoop, State* substates[], size_t substateCount)
+StatePower GetStatePower(State* state)
 {
-    if (newState)
+    StatePower power = { STATE_SLEEP_DEEPEST, 0 };
+    if (state)
     {
-        newState->_OnEnterState = enter;
-        newState->_OnExitState = exit;
-        newState->OnInterrupt = 0;
-        newState->_OnLoop = BubblingOnLoop;
-        newState->_storage = StatePrivateInitWSubstates(NewStatePrivate(substateCount), parentState, onLoop, substates, substateCount);
+        power.deepestSleep = TINKER_READ_BYTE(&state->_descriptor->power.deepestSleep);
+        power.peripherals = TINKER_READ_BYTE(&state->_descriptor->power.peripherals);
     }
-    return newState;
+    return power;
 }
 
-void StateDestructor(State* state)
+void* StateGetUserData(State* state)
 {
-    if (state)
-    {
-        StatePrivateDelete((StatePrivate*)state->_storage);
-    }
+    return (state) ? _DESCRIPTOR_FIELD(state, userData) : 0;
 }
 
+/**
+ * Enter a single state. The Machine enters ancestors first.
+ */
 StateErrorType StateEnter(State* state, void* data, uint8_t datalen)
 {
     StateErrorType result = STATE_ERROR_NONE;
-    if (state)
+    if (state && !state->_isEntered)
     {
-        StatePrivate* priv = (StatePrivate*)state->_storage;
-        if (!priv->isEntered)
-        {
-            if (priv->parent)
-            {
-                result = StateEnter(priv->parent, data, datalen);
-            }
-            if (STATE_ERROR_NONE == result)
-            {
-                result = (state->_OnEnterState) ? state->_OnEnterState(state, data, datalen) : STATE_ERROR_NONE;
-                priv->isEntered = (STATE_ERROR_NONE == result);
-            }
-        }
+        const StateTransitionFunc onEnter = (StateTransitionFunc)_DESCRIPTOR_FIELD(state, onEnter);
+        result = (onEnter) ? onEnter(state, data, datalen) : STATE_ERROR_NONE;
+        const TinkerCriticalState critical = TinkerEnterCritical();
+        state->_isEntered = (STATE_ERROR_NONE == result);
+        TinkerExitCritical(critical);
     }
     return result;
 }
 
+/**
+ * Exit a single state. The Machine exits children first.
+ */
 StateErrorType StateExit(State* state, void* data, uint8_t datalen)
 {
     StateErrorType result = STATE_ERROR_NONE;
-    if (state)
+    if (state && state->_isEntered)
     {
-        StatePrivate* priv = (StatePrivate*)state->_storage;
-        if (priv->isEntered)
-        {
-            priv->isEntered = 0;
-            for(size_t i = 0; i < priv->childStateCount; ++i)
-            {
-                result = StateExit(priv->childStates[i], data, datalen);
-                if (STATE_ERROR_NONE != result)
-                {
-                    break;
-                }
-            }
-            if (STATE_ERROR_NONE == result)
-            result = (state->_OnExitState) ? state->_OnExitState(state, data, datalen) : STATE_ERROR_NONE;
-        }
+        const TinkerCriticalState critical = TinkerEnterCritical();
+        state->_isEntered = 0;
+        TinkerExitCritical(critical);
+        const StateTransitionFunc onExit = (StateTransitionFunc)_DESCRIPTOR_FIELD(state, onExit);
+        result = (onExit) ? onExit(state, data, datalen) : STATE_ERROR_NONE;
     }
     return result;
 }
 
 bool StateIsEntered(State* state)
 {
-    bool isEntered = false;
-    if (state) {
-        StatePrivate* priv = (StatePrivate*)state->_storage;
-        isEntered = priv->isEntered;
-    }
-    return isEntered;
+    return (state && state->_isEntered);
 }
 
-StateErrorType StateHandleInterrupt(State* state, StateInterruptType interruptType)
+StateErrorType StateHandleEvent(State* state, StateEventType event)
 {
-    if (state && state->OnInterrupt)
+    if (state && event < TINKER_READ_BYTE(&state->_descriptor->eventCount))
     {
-        return state->OnInterrupt(state, interruptType);
+        const StateEventFunc* events = (const StateEventFunc*)_DESCRIPTOR_FIELD(state, events);
+        const StateEventFunc onEvent = (StateEventFunc)TINKER_READ_PTR(&events[event]);
+        if (onEvent)
+        {
+            return onEvent(state, event);
+        }
     }
     return STATE_ERROR_FALSE;
 }
 
 bool IsRootState(State* state)
 {
-    bool result = false;
-
-    if (state)
-    {
-        result = (((StatePrivate*)state->_storage)->parent == 0);
-    }
-
-    return result;
+    return (state && !GetParentState(state));
 }
 
 State* GetParentState(State* state)
 {
-    State* result = 0;
-    if (state)
-    {
-        result = ((StatePrivate*)state->_storage)->parent;
-    }
-    return result;
-}
-
-int8_t StateIsChildOf(State* state, State* possibleAncestor)
-{
-    int8_t result = 0;
-    if (state)
-    {
-        State* possibleParent = GetParentState(state);
-        while(possibleParent)
-        {
-            if(possibleParent == possibleAncestor)
-            {
-                result = 1;
-                break;
-            }
-            possibleParent = GetParentState(possibleParent);
-        }
-    }
-    return result;
+    return (state) ? (State*)_DESCRIPTOR_FIELD(state, parent) : 0;
 }
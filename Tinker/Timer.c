@@ -0,0 +1,240 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "tinker/Timer.h"
+
+/**
+ * Apply the time elapsed since the last sync to the front of the list. Timers
+ * whose deadline has passed move to the end of the expired list with their
+ * delta reused for how late they are.
+ */
+static void _syncTimers(TimerService* service)
+{
+    uint16_t elapsed = service->_elapsed();
+    Timer** tail = &service->_expired;
+    for (; *tail; tail = &(*tail)->_next)
+    {
+        // Still waiting to be dispatched so later still.
+        (*tail)->_delta = ((*tail)->_delta > 0xFFFF - elapsed) ? 0xFFFF : (*tail)->_delta + elapsed;
+    }
+    while (service->_head && service->_head->_delta <= elapsed)
+    {
+        Timer* timer = service->_head;
+        elapsed -= timer->_delta;
+        service->_head = timer->_next;
+        timer->_delta = elapsed;
+        timer->_next = 0;
+        *tail = timer;
+        tail = &timer->_next;
+    }
+    if (service->_head)
+    {
+        service->_head->_delta -= elapsed;
+    }
+}
+
+static void _insertTimer(TimerService* service, Timer* timer, uint16_t delayMillis)
+{
+    Timer** link = &service->_head;
+    while (*link && (*link)->_delta <= delayMillis)
+    {
+        delayMillis -= (*link)->_delta;
+        link = &(*link)->_next;
+    }
+    if (*link)
+    {
+        (*link)->_delta -= delayMillis;
+    }
+    timer->_delta = delayMillis;
+    timer->_next = *link;
+    timer->_isScheduled = 1;
+    *link = timer;
+}
+
+static void _removeTimer(TimerService* service, Timer* timer)
+{
+    uint8_t isFound = 0;
+    for (Timer** link = &service->_head; *link; link = &(*link)->_next)
+    {
+        if (*link == timer)
+        {
+            *link = timer->_next;
+            if (timer->_next)
+            {
+                timer->_next->_delta += timer->_delta;
+            }
+            isFound = 1;
+            break;
+        }
+    }
+    // Expired timers' deltas are independent of each other.
+    for (Timer** link = &service->_expired; *link && !isFound; link = &(*link)->_next)
+    {
+        if (*link == timer)
+        {
+            *link = timer->_next;
+            isFound = 1;
+        }
+    }
+    timer->_next = 0;
+    timer->_isScheduled = 0;
+}
+
+static void _armTimerSource(TimerService* service)
+{
+    uint16_t millis = 0;
+    if (service->_expired)
+    {
+        // Synced outside of the port handler. Dispatch them next alarm.
+        millis = 1;
+    }
+    else if (service->_head)
+    {
+        // A timer scheduled with no delay still waits for the next alarm.
+        millis = service->_head->_delta ? service->_head->_delta : 1;
+    }
+    service->_arm(millis);
+}
+
+static uint8_t _HandlePortMessage(RunLoopPort* port, RunLoop* runLoop, RunLoopMessageType messageType, RunLoopMessageData data)
+{
+    if (RUNLOOP_MESSAGE_TIMER == messageType)
+    {
+        TimerService* service = (TimerService*)port->userData;
+        _syncTimers(service);
+        while (service->_expired)
+        {
+            Timer* timer = service->_expired;
+            const uint16_t late = timer->_delta;
+            service->_expired = timer->_next;
+            timer->_next = 0;
+            timer->_isScheduled = 0;
+            if (timer->_period)
+            {
+                // Keep to the original schedule rather than drifting by
+                // however late this was dispatched.
+                _insertTimer(service, timer, (timer->_period > late) ? timer->_period - late : 0);
+            }
+            // The callback is free to reschedule or cancel any timer (including this one).
+            timer->_onTimer(timer);
+        }
+        _armTimerSource(service);
+        return 1;
+    }
+    return 0;
+}
+
+Timer* TimerInit(Timer* timer, OnTimerFunc handler)
+{
+    if (timer)
+    {
+        timer->_next = 0;
+        timer->_delta = 0;
+        timer->_period = 0;
+        timer->_onTimer = handler;
+        timer->_isScheduled = 0;
+    }
+    return timer;
+}
+
+TimerService* TimerServiceInit(TimerService* service, RunLoop* runLoop, TimerSourceElapsedFunc elapsed, TimerSourceArmFunc arm)
+{
+    if (service)
+    {
+        if (RUNLOOP_MAX_PORTS == AddPort(runLoop, &service->_port))
+        {
+            service = 0;
+        }
+        else
+        {
+            service->_head = 0;
+            service->_expired = 0;
+            service->_elapsed = elapsed;
+            service->_arm = arm;
+            service->_runLoop = runLoop;
+            InitRunLoopPort(&service->_port, _HandlePortMessage);
+            service->_port.userData = service;
+        }
+    }
+    return service;
+}
+
+void ScheduleTimer(TimerService* service, Timer* timer, uint16_t delayMillis, uint16_t periodMillis)
+{
+    if (service && timer)
+    {
+        _syncTimers(service);
+        if (timer->_isScheduled)
+        {
+            _removeTimer(service, timer);
+        }
+        timer->_period = periodMillis;
+        _insertTimer(service, timer, delayMillis);
+        _armTimerSource(service);
+    }
+}
+
+void CancelTimer(TimerService* service, Timer* timer)
+{
+    if (service && timer && timer->_isScheduled)
+    {
+        _syncTimers(service);
+        _removeTimer(service, timer);
+        _armTimerSource(service);
+    }
+}
+
+bool IsTimerScheduled(Timer* timer)
+{
+    return (timer && timer->_isScheduled);
+}
+
+uint16_t GetTimerRemaining(TimerService* service, Timer* timer)
+{
+    uint16_t remaining = 0;
+    if (service && timer && timer->_isScheduled)
+    {
+        // The hardware deadline is absolute so it stays armed across the sync.
+        _syncTimers(service);
+        // Not found means it's expired and waiting to be dispatched.
+        uint16_t deadline = 0;
+        for (Timer* each = service->_head; each; each = each->_next)
+        {
+            deadline += each->_delta;
+            if (each == timer)
+            {
+                remaining = deadline;
+                break;
+            }
+        }
+    }
+    return remaining;
+}
+
+bool HasScheduledTimers(TimerService* service)
+{
+    return (service && (service->_head || service->_expired));
+}
+
+void TimerServiceAlarm(TimerService* service)
+{
+    if (service && !PostRunLoopMessage(service->_runLoop, RUNLOOP_MESSAGE_TIMER, 0))
+    {
+        // The queue is full. Nothing else would re-arm the source so try
+        // again shortly rather than lose the deadline.
+        service->_arm(1);
+    }
+}
@@ -40,6 +40,12 @@ typedef uint8_t ButtonEventType;
  */
 #define BUTTON_EVENT_LONG_PRESS 3
 
+/**
+ * Second release of a button pressed twice in quick succession. Follows the
+ * BUTTON_EVENT_UP. Only reported by ButtonGroup.
+ */
+#define BUTTON_EVENT_DOUBLE_CLICK 4
+
 struct _ButtonType;
 
 /**
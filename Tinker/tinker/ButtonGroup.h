@@ -0,0 +1,137 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * \file ButtonGroup.h
+ * Debounces up to 8 buttons on one GPIO port at once. Each sample is a whole
+ * port byte run through vertical counters (one bit of each counter byte per
+ * button) so the cost of a sample doesn't grow with the number of buttons.
+ */
+
+#ifndef BUTTONGROUP_H_
+#define BUTTONGROUP_H_
+
+#include "tinker/Button.h"
+#include "tinker/RunLoop.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+struct _ButtonGroupType;
+
+/**
+ * Function type for button group event handlers.
+ * \param source    The group the event originated from.
+ * \param event     A BUTTON_EVENT_XXXX value.
+ * \param buttons   Mask of the port bits the event applies to.
+ */
+typedef void (*OnButtonGroupEventFunc)(struct _ButtonGroupType* source, ButtonEventType event, uint8_t buttons);
+
+/**
+ * \struct ButtonGroup
+ *
+ * Button group object. Feed it port samples with
+ * RUNLOOP_MESSAGE_BUTTONGROUPSAMPLE messages, one per millisecond.
+ */
+typedef struct _ButtonGroupType
+{
+    /**
+     * Vertical counter of consecutive samples that disagree with _pressed.
+     */
+    uint8_t _count0;
+    uint8_t _count1;
+    uint8_t _count2;
+    uint8_t _pressed;
+    uint8_t _mask;
+    uint8_t _activeLow;
+    /**
+     * Buttons still held since the last down event and how long it's been.
+     */
+    uint8_t _longPressButtons;
+    uint16_t _heldSamples;
+    /**
+     * Buttons released recently enough that pressing them again makes a
+     * double click, and those pressed again in time.
+     */
+    uint8_t _clickedButtons;
+    uint8_t _secondPressButtons;
+    uint16_t _releasedSamples;
+    OnButtonGroupEventFunc _onButtonEvent;
+    RunLoopPort _port;
+} ButtonGroup;
+
+/**
+ * Objective-C style button group initializer.
+ * \param group      The group instance to initialize.
+ * \param mask       The port bits with buttons on them.
+ * \param activeLow  The port bits that read 0 while their button is pressed.
+ * \param handler    A handler function to invoke when events occur for any
+ *                   button in the group.
+ * \param runLoop    The runloop used to process port samples and generate
+ *                   button events.
+ * \return A pointer to the initialized group or 0 if the runloop has no free
+ *         ports.
+ */
+ButtonGroup* ButtonGroupInit(ButtonGroup* group, uint8_t mask, uint8_t activeLow, OnButtonGroupEventFunc handler, RunLoop* runLoop);
+
+/**
+ * Feed the group a port sample directly rather than through the runloop. Use
+ * this from code already running in the runloop's context (e.g. a timer
+ * callback): PostRunLoopMessage only allows one producer context, which is
+ * normally taken by interrupts.
+ * \param group     The group to sample.
+ * \param sample    The port byte.
+ */
+void ButtonGroupSample(ButtonGroup* group, uint8_t sample);
+
+/**
+ * \return Mask of the buttons currently (debounced) pressed.
+ */
+uint8_t GetButtonGroupPressed(ButtonGroup* group);
+
+/**
+ * Query a group to discover if every button's last sample agreed with its
+ * debounced state. Applications that only sample in bursts after an edge
+ * interrupt can stop once this has held for a few samples. Long press and
+ * double click are counted in samples so use a Gesture for those instead.
+ * \return true if nothing is being debounced.
+ */
+bool IsButtonGroupSettled(ButtonGroup* group);
+
+// +--------------------------------------------------------------------------+
+// | BUTTON GROUP TUNING
+// +--------------------------------------------------------------------------+
+/**
+ * Buttons change state after 8 consecutive samples that agree (the vertical
+ * counters are 3 bits). Long press is measured from the down event.
+ */
+#ifndef BUTTON_GROUP_SAMPLES_IS_LONGPRESS
+#define BUTTON_GROUP_SAMPLES_IS_LONGPRESS BUTTON_DOWNSAMPLES_IS_LONGPRESS
+#endif
+
+/**
+ * Most samples between releasing a button and pressing it again for the
+ * second release to be reported as a double click.
+ */
+#ifndef BUTTON_GROUP_SAMPLES_IS_DOUBLECLICK
+#define BUTTON_GROUP_SAMPLES_IS_DOUBLECLICK 300
+#endif
+
+/**
+ * The low byte of the message data is the port sample.
+ */
+#define RUNLOOP_MESSAGE_BUTTONGROUPSAMPLE 3
+
+#endif /* BUTTONGROUP_H_ */
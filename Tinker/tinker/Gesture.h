@@ -0,0 +1,120 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * \file Gesture.h
+ * Recognizes multi-clicks, holds and hold-repeat from the debounced down and
+ * up events of one button. Runs only on button events and a single timer so
+ * it adds nothing to the cost of sampling.
+ *
+ *   down..up                     GESTURE_EVENT_CLICK (1)
+ *   down..up..down..up           GESTURE_EVENT_CLICK (1), GESTURE_EVENT_CLICK (2)
+ *   ...then nothing for a while  GESTURE_EVENT_CLICKS_DONE (clicks)
+ *   down.............            GESTURE_EVENT_HOLD (clicks before the hold)
+ *   ...still down                GESTURE_EVENT_HOLD_REPEAT (1, 2, 3...)
+ *   ...up                        GESTURE_EVENT_HOLD_RELEASE (repeats)
+ *
+ * Clicks are reported as they happen so single clicks stay responsive. The
+ * count of a hold release classifies how long the press lasted: 0 was
+ * released before the first repeat and so on.
+ *
+ * Chords (several buttons of a ButtonGroup pressed together) are not
+ * recognized. Each Gesture watches one button, so use one per button and
+ * compare ButtonGroup masks if chords are needed.
+ */
+
+#ifndef GESTURE_H_
+#define GESTURE_H_
+
+#include "tinker/Button.h"
+#include "tinker/Timer.h"
+#include <stdint.h>
+
+/**
+ * Type able to store any GESTURE_EVENT_XXXX value.
+ */
+typedef uint8_t GestureEventType;
+
+#define GESTURE_EVENT_CLICK         1
+#define GESTURE_EVENT_CLICKS_DONE   2
+#define GESTURE_EVENT_HOLD          3
+#define GESTURE_EVENT_HOLD_REPEAT   4
+#define GESTURE_EVENT_HOLD_RELEASE  5
+
+struct _GestureType;
+
+/**
+ * Function type for gesture event handlers.
+ * \param source    The gesture recognizer the event originated from.
+ * \param event     The event type.
+ * \param count     Clicks or repeats so far. See above.
+ */
+typedef void (*OnGestureEventFunc)(struct _GestureType* source, GestureEventType event, uint8_t count);
+
+/**
+ * \struct Gesture
+ *
+ * Gesture recognizer object.
+ */
+typedef struct _GestureType
+{
+    /**
+     * Opaque pointer available for external use.
+     * This pointer is neither read nor written by the
+     * Gesture object.
+     */
+    void* userData;
+    uint8_t _state;
+    uint8_t _count;
+    uint16_t _holdMillis;
+    uint16_t _repeatMillis;
+    OnGestureEventFunc _onGestureEvent;
+    TimerService* _timerService;
+    Timer _timer;
+} Gesture;
+
+/**
+ * Objective-C style gesture recognizer initializer.
+ * \param gesture       The gesture instance to initialize.
+ * \param handler       A handler function to invoke when gestures occur.
+ * \param timerService  The service used to time holds and multi-clicks.
+ * \param holdMillis    How long a press lasts before it is a hold.
+ * \param repeatMillis  Period of GESTURE_EVENT_HOLD_REPEAT once holding or 0
+ *                      for none.
+ * \return A pointer to the initialized gesture instance.
+ */
+Gesture* GestureInit(Gesture* gesture, OnGestureEventFunc handler, TimerService* timerService, uint16_t holdMillis, uint16_t repeatMillis);
+
+/**
+ * Feed the recognizer an event from the button it watches. Only
+ * BUTTON_EVENT_DOWN and BUTTON_EVENT_UP are used, anything else is ignored.
+ * \param gesture   The recognizer.
+ * \param event     The button event.
+ */
+void GestureHandleButtonEvent(Gesture* gesture, ButtonEventType event);
+
+// +--------------------------------------------------------------------------+
+// | GESTURE TUNING
+// +--------------------------------------------------------------------------+
+/**
+ * Most time between releasing the button and pressing it again for the
+ * press to continue the same multi-click.
+ */
+#ifndef GESTURE_MULTICLICK_MILLIS
+#define GESTURE_MULTICLICK_MILLIS 300
+#endif
+
+#endif /* GESTURE_H_ */
@@ -20,8 +20,43 @@ limitations under the License.
 
 #include "tinker/State.h"
 
+/**
+ * The most states a Machine can manage. Transitions use a table of least
+ * common ancestors that grows with the square of this.
+ */
+#ifndef MACHINE_MAX_STATES
+#define MACHINE_MAX_STATES 6
+#endif
+
+#define MACHINE_LCA_TABLE_SIZE ((MACHINE_MAX_STATES * (MACHINE_MAX_STATES + 1)) / 2)
+
+/**
+ * The most loop functions the focus and its ancestors can have between them.
+ */
+#ifndef MACHINE_MAX_LOOP_FUNCS
+#define MACHINE_MAX_LOOP_FUNCS 3
+#endif
+
+/**
+ * The most transitions RequestMachineState can hold before the main loop runs
+ * them. Once full the newest request replaces the last one queued.
+ */
+#ifndef MACHINE_MAX_PENDING_TRANSITIONS
+#define MACHINE_MAX_PENDING_TRANSITIONS 2
+#endif
+
 struct _MachineType;
 
+/**
+ * A transition waiting for RunMachineTransitions.
+ */
+typedef struct _MachineTransitionType
+{
+    State* state;
+    void* data;
+    uint8_t dataLen;
+} MachineTransition;
+
 typedef void (*OnStateChangeFunc)(struct _MachineType* machine, State* oldState, State* newState);
 
 /**
@@ -36,25 +71,50 @@ typedef struct _MachineType
      * Machine object.
      */
     void* userData;
-    void* _data;
+    State* _focus;
+    OnStateChangeFunc _stateChangeHandler;
+    uint8_t _stateCount;
+    /**
+     * Index of the least common ancestor of every pair of states (lower
+     * triangle, the table is symmetric) or STATE_INDEX_NONE.
+     */
+    uint8_t _lca[MACHINE_LCA_TABLE_SIZE];
+    /**
+     * Loop functions of the focus and its ancestors, innermost first, with
+     * the state each belongs to. Rebuilt when the focus changes.
+     */
+    StateFunc _loopFuncs[MACHINE_MAX_LOOP_FUNCS];
+    State* _loopStates[MACHINE_MAX_LOOP_FUNCS];
+    uint8_t _loopFuncCount;
+    /**
+     * Combined power needs of the focus and its ancestors. Rebuilt when the
+     * focus changes.
+     */
+    StatePower _power;
+    MachineTransition _pending[MACHINE_MAX_PENDING_TRANSITIONS];
+    volatile uint8_t _pendingCount;
 } Machine;
 
 /**
- * Objective-C style object initializer for Machine types.
+ * Objective-C style object initializer for Machine types. Works out the
+ * least common ancestor of every pair of states up front so transitions
+ * only ever visit the states they exit and enter.
  * \param  machine              The machine object to initialize.
  * \param  stateChangeHandler   A state change handler method to set
  *                              for the machine object.
+ * \param  states               Every state the machine will be asked to move
+ *                              into along with all of their ancestors.
+ * \param  stateCount           The number of states. At most MACHINE_MAX_STATES.
+ * \return A pointer to the initialized machine or 0 if there were too many
+ *         states or one of them has more than MACHINE_MAX_LOOP_FUNCS loop
+ *         functions between it and its ancestors.
  */
-Machine* MachineInit(Machine* machine, OnStateChangeFunc stateChangeHandler);
-
-/**
- * Machine de-initializer. This method may de-allocate internal data but will
- * not free the machine pointer (i.e. this is a destructor not a deleter).
- */
-void MachineDestructor(Machine* machine);
+Machine* MachineInit(Machine* machine, OnStateChangeFunc stateChangeHandler, State* const states[], uint8_t stateCount);
 
 /**
- * Instruct a machine to move into a given state.
+ * Instruct a machine to move into a given state. The transition runs before
+ * this returns so only call it from the main loop (e.g. from a loop function).
+ * Use RequestMachineState from event handlers and ISRs.
  * \param  machine  The machine to request a state change for.
  * \param  state    The state to move the machine into.
  */
@@ -66,9 +126,74 @@ StateErrorType SetMachineState(Machine* machine, State* state);
  * \param  state    The state to move the machine into.
  * \param  data     The data to provide with the state transition.
  * \param  dataLen  The size in bytes of the data argument.
+ * \return STATE_ERROR_INVALID if the state wasn't given to MachineInit,
+ *         otherwise the result of the first exit or enter function to fail
+ *         or STATE_ERROR_NONE.
  */
 StateErrorType SetMachineStateWData(Machine* machine, State* state, void* data, uint8_t dataLen);
 
+/**
+ * Queue a transition for the next RunMachineTransitions. Only takes a few
+ * microseconds so it is safe from an ISR. A request for the state already
+ * at the back of the queue only replaces the data it carries. A request for
+ * the focus when nothing is queued is dropped, data and all, since the state
+ * is already entered. When the queue is full the last request is replaced.
+ * Nothing is copied: the data and dataLen given to RequestMachineStateWData
+ * are passed to the enter functions as they were, so the data must outlive
+ * the transition.
+ * \param  machine  The machine to request a state change for.
+ * \param  state    The state to move the machine into.
+ * \return STATE_ERROR_INVALID if the state wasn't given to MachineInit
+ *         otherwise STATE_ERROR_NONE.
+ */
+StateErrorType RequestMachineState(Machine* machine, State* state);
+
+/**
+ * RequestMachineState passing along opaque data with the state transition.
+ * The data must still be valid when the transition runs (see
+ * RequestMachineState).
+ */
+StateErrorType RequestMachineStateWData(Machine* machine, State* state, void* data, uint8_t dataLen);
+
+/**
+ * Run queued transitions, oldest first, including any queued while doing so.
+ * Call from the main loop.
+ * \param  machine  The machine to run transitions for.
+ */
+void RunMachineTransitions(Machine* machine);
+
+/**
+ * \return true if RunMachineTransitions has work to do.
+ */
+bool HasPendingMachineTransitions(Machine* machine);
+
+/**
+ * Run the loop functions of the focus and all of its ancestors, innermost
+ * first. The list is worked out when the focus changes so this is just a
+ * few indirect calls.
+ * \param  machine  The machine to run.
+ */
+void MachineLoop(Machine* machine);
+
+/**
+ * Offer an event to the focus then to each of its ancestors in turn until one
+ * of them handles it. Each state is a single lookup in its event table.
+ * \param  machine  The machine to dispatch the event to.
+ * \param  event    The event to dispatch.
+ * \return STATE_ERROR_FALSE if no state handled the event otherwise the
+ *         result of the state that did. See StateHandleEvent.
+ */
+StateErrorType DispatchMachineEvent(Machine* machine, StateEventType event);
+
+/**
+ * Combine the power needs of the focus and all of its ancestors: the lightest
+ * of their deepest sleeps and every peripheral any of them need. Worked out
+ * when the focus changes so this is cheap enough to call before every sleep.
+ * \param  machine  The machine to query.
+ * \return What the entered states allow. No limits if there is no focus.
+ */
+StatePower GetMachinePower(Machine* machine);
+
 /**
  * Get the leaf state at the bottom of the current state hierarchy.
  * \param  machine  The machine to get the state from.
@@ -0,0 +1,99 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ * \file Platform.h
+ * The few things Tinker needs from the target that C doesn't provide. AVR
+ * builds keep constant tables in flash; everything else uses plain memory.
+ *
+ * Work that mustn't interleave with interrupt handlers (or other threads on a
+ * host) is bracketed with
+ *
+ *     const TinkerCriticalState state = TinkerEnterCritical();
+ *     ...
+ *     TinkerExitCritical(state);
+ *
+ * Exiting restores whatever was in effect on entry so critical sections nest
+ * and are safe to use from an ISR. Define TINKER_CRITICAL_EXTERN to supply
+ * TinkerEnterCritical and TinkerExitCritical yourself (e.g. a recursive mutex
+ * for a multi-threaded host). Otherwise AVR builds save and restore SREG and
+ * host builds, assumed single threaded, only stop the compiler reordering
+ * memory accesses across the boundary.
+ */
+
+#ifndef PLATFORM_H_
+#define PLATFORM_H_
+
+#include <stdint.h>
+
+typedef uint8_t TinkerCriticalState;
+
+#if defined(__AVR__)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+/**
+ * Place a const object in program memory. Objects placed there must only be
+ * read through TINKER_READ_PTR/TINKER_READ_BYTE.
+ */
+#define TINKER_PROGMEM PROGMEM
+#define TINKER_READ_PTR(ADDRESS) ((void*)(uintptr_t)pgm_read_word(ADDRESS))
+#define TINKER_READ_BYTE(ADDRESS) pgm_read_byte(ADDRESS)
+
+#ifndef TINKER_CRITICAL_EXTERN
+static inline TinkerCriticalState TinkerEnterCritical(void)
+{
+    const TinkerCriticalState sreg = SREG;
+    cli();
+    return sreg;
+}
+
+static inline void TinkerExitCritical(TinkerCriticalState state)
+{
+    __asm__ volatile ("" ::: "memory");
+    SREG = state;
+}
+#endif
+
+#else
+
+#define TINKER_PROGMEM
+#define TINKER_READ_PTR(ADDRESS) (*(void* const*)(ADDRESS))
+#define TINKER_READ_BYTE(ADDRESS) (*(const uint8_t*)(ADDRESS))
+
+#ifndef TINKER_CRITICAL_EXTERN
+static inline TinkerCriticalState TinkerEnterCritical(void)
+{
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static inline void TinkerExitCritical(TinkerCriticalState state)
+{
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+#endif
+
+#ifdef TINKER_CRITICAL_EXTERN
+TinkerCriticalState TinkerEnterCritical(void);
+void TinkerExitCritical(TinkerCriticalState state);
+#endif
+
+#endif /* PLATFORM_H_ */
@@ -22,8 +22,24 @@ limitations under the License.
 #define RUNLOOP_MAX_PORTS 2
 #endif
 
+/**
+ * Capacity of the message queue used by \link PostRunLoopMessage \endlink.
+ * Must be a power of 2 no larger than 128.
+ */
+#ifndef RUNLOOP_QUEUE_SIZE
+#define RUNLOOP_QUEUE_SIZE 8
+#endif
+
 #include <stdint.h>
 
+/**
+ * Fails to compile (negative array size) unless RUNLOOP_QUEUE_SIZE is a power
+ * of 2 no larger than 128. The queue indices wrap with a mask and are single
+ * bytes.
+ */
+typedef char _RunLoopQueueSizeCheck[(RUNLOOP_QUEUE_SIZE > 0 && RUNLOOP_QUEUE_SIZE <= 128 &&
+                                     !(RUNLOOP_QUEUE_SIZE & (RUNLOOP_QUEUE_SIZE - 1))) ? 1 : -1];
+
 struct _RunLoopType;
 struct _RunLoopPortType;
 
@@ -76,6 +92,16 @@ RunLoopPort* InitRunLoopPort(RunLoopPort* newPort, OnHandlePortMessageFunc handl
  */
 typedef uint8_t (*RunModeFunc)(struct _RunLoopType* runLoop, RunLoopMessageType messageType, RunLoopMessageData messageData);
 
+/**
+ * \struct RunLoopMessage
+ * A message waiting in a RunLoop's queue.
+ */
+typedef struct _RunLoopMessageEntryType
+{
+    RunLoopMessageType type;
+    RunLoopMessageData data;
+} RunLoopMessage;
+
 /**
  * \struct RunLoop
  * Object type for Cocoa style RunLoop. This (obviously) is a vastly
@@ -85,14 +111,27 @@ typedef struct _RunLoopType
 {
     RunLoopPort* _ports[RUNLOOP_MAX_PORTS];
     uint8_t _portCount;
+    RunLoopMessage _queue[RUNLOOP_QUEUE_SIZE];
+    volatile uint8_t _queueHead;
+    volatile uint8_t _queueTail;
 
     /**
-     * The method to invoke when driving this runloop. For example to drive
-     * a runloop from a timer interrupt (AVR example given here) do:
+     * The method to invoke when driving this runloop. This dispatches
+     * synchronously so calling it from an interrupt runs every port handler in
+     * interrupt context. To drive a runloop from a timer interrupt (AVR example
+     * given here) post to it instead and drain it from the main loop:
      * <pre>
-     * ISR(TIM0_OVF_vect)
-     * {
-     *     myTimer0RunLoop->runMode(myTimer0RunLoop, SOME_MESSAGE_ID, 0);
+     * ISR(TIM0_OVF_vect)
+     * {
+     *     PostRunLoopMessage(myRunLoop, SOME_MESSAGE_ID, 0);
+     * }
+     *
+     * int main(void)
+     * {
+     *     while(1)
+     *     {
+     *         DrainRunLoop(myRunLoop);
+     *     }
      * }
      * </pre>
      */
@@ -134,4 +173,31 @@ uint8_t AddPort(RunLoop* runLoop, RunLoopPort* port);
  */
 RunLoopPort* RemovePort(RunLoop* runLoop, uint8_t portNumber);
 
+/**
+ * Queue a message to be dispatched by \link DrainRunLoop \endlink. The queue
+ * is lock-free with a single producer and a single consumer so this is safe to
+ * call from an interrupt as long as all posts to a given runloop come from
+ * contexts that cannot preempt each other (e.g. non-nesting AVR ISRs).
+ * \param  runLoop      The runloop to post the message to.
+ * \param  messageType  The message type. This identifier is opaque to the Tinker framework.
+ * \param  messageData  Opaque data to pass to \link RunLoopPort \endlink objects.
+ * \return 1 if the message was queued or 0 if the queue was full.
+ */
+uint8_t PostRunLoopMessage(RunLoop* runLoop, RunLoopMessageType messageType, RunLoopMessageData messageData);
+
+/**
+ * Dispatch all queued messages, in order, through the runloop's runMode.
+ * Must only be called from one context (normally the main loop).
+ * \param  runLoop  The runloop to drain.
+ * \return The number of messages dispatched.
+ */
+uint8_t DrainRunLoop(RunLoop* runLoop);
+
+/**
+ * Query a runloop for queued messages.
+ * \param  runLoop  The runloop to query.
+ * \return 1 if there are messages waiting to be drained else 0.
+ */
+uint8_t HasRunLoopMessages(RunLoop* runLoop);
+
 #endif /* RUNLOOP_H_ */
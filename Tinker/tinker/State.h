@@ -21,6 +21,7 @@ limitations under the License.
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include "tinker/Platform.h"
 
 // +--------------------------------------------------------------------------+
 // | STATE TYPES
@@ -39,13 +40,10 @@ typedef int8_t StateErrorType;
 #define STATE_ERROR_INTERNAL -0x02
 
 /**
- * Type all STATE_INT_XXXX values can be interpreted as.
+ * Events are small, dense, application defined integers starting at 0. They
+ * index directly into the event table of each state.
  */
-typedef int8_t StateInterruptType;
-
-// TODO: This isn't well factored. Think though more how to generically
-//       classify interrupts and allow states to handle them.
-#define STATE_INT_BUTTON_CLICK 0x01
+typedef uint8_t StateEventType;
 
 /**
  * Type for any state transition handling functions. See
@@ -66,82 +64,140 @@ typedef StateErrorType (*StateTransitionFunc)(struct _StateType* state, void* da
 typedef void (*StateFunc)(struct _StateType*);
 
 /**
- * Type for function allowing a state to optionally handle various interrupts.
- * \param  state            The state this message is being dispatched to.
- * \param  interruptType    The type of interrupt currently being processed.
- * \return STATE_ERROR_FALSE to decline to handle the interrupt, STATE_ERROR_NONE
- *         to indicate the interrupt has been handled, or another STATE_ERROR_XXXX
- *         to indicate the state tried but failed to handle the interrupt.
+ * Type for functions handling events dispatched to a state.
+ * \param  state    The state this event is being dispatched to.
+ * \param  event    The event currently being processed.
+ * \return STATE_ERROR_FALSE to decline the event and let it bubble up to the
+ *         parent state, STATE_ERROR_NONE to indicate the event has been handled,
+ *         or another STATE_ERROR_XXXX to indicate the state tried but failed
+ *         to handle the event.
  */
-typedef StateErrorType (*StateInterruptFunc)(struct _StateType* state, StateInterruptType interruptType);
+typedef StateErrorType (*StateEventFunc)(struct _StateType* state, StateEventType event);
 
 /**
- * \struct State
- * A Hierarchical State object type.
+ * \struct StatePower
+ * What a state needs from the hardware while it or one of its children has
+ * focus. Both fields are defined by the application: sleep levels are ordered
+ * from lightest (0) to deepest and peripherals is a mask of those that must
+ * stay clocked. See \link GetMachinePower \endlink.
  */
-typedef struct _StateType
+typedef struct _StatePowerType
+{
+    uint8_t deepestSleep;
+    uint8_t peripherals;
+} StatePower;
+
+#define STATE_SLEEP_DEEPEST 0xFF
+
+/**
+ * \struct StateDescriptor
+ * The constant part of a state. Declared with TINKER_STATE and kept in
+ * program memory on targets that support it.
+ */
+typedef struct _StateDescriptorType
 {
     /**
-     * Optional interrupt handler. Initialized to 0
-     * by State init methods, specializations of State
-     * can provide their own to be given a chance to process
-     * various interrupts.
+     * The parent state in the hierarchy. 0 for the root state.
      */
-    StateInterruptFunc OnInterrupt;
-
+    struct _StateType* parent;
+    StateTransitionFunc onEnter;
+    StateTransitionFunc onExit;
+    /**
+     * Invoked while this state or any of its children has focus.
+     */
+    StateFunc onLoop;
+    /**
+     * Optional table of event handlers indexed by event. Entries may be 0.
+     * Kept in program memory along with the descriptor.
+     */
+    const StateEventFunc* events;
+    uint8_t eventCount;
+    StatePower power;
     /**
-     * Opaque pointer available for external use.
-     * This pointer is neither read nor written by the
-     * Machine object nor the State object.
+     * Opaque pointer available for external use. Neither read nor written
+     * by the Machine object nor the State object.
      */
     void* userData;
-    StateFunc _OnLoop;
-    StateTransitionFunc _OnEnterState;
-    StateTransitionFunc _OnExitState;
-    void* _storage;
+} StateDescriptor;
+
+/**
+ * \struct State
+ * A Hierarchical State object type. Only the entered flag and the index the
+ * Machine assigns live in RAM.
+ */
+typedef struct _StateType
+{
+    const StateDescriptor* _descriptor;
+    uint8_t _isEntered;
+    /**
+     * Assigned by the Machine the state is registered with.
+     */
+    uint8_t _index;
 } State;
 
-// +--------------------------------------------------------------------------+
-// | STATE METHODS
-// +--------------------------------------------------------------------------+
+#define STATE_INDEX_NONE 0xFF
+
+/**
+ * Statically declare a state. The whole hierarchy is built from these at
+ * compile time; there is nothing to initialize and nothing is allocated.
+ * \param  NAME        The name of the State object to define.
+ * \param  PARENT      A pointer to the parent state or 0 for the root state.
+ * \param  ENTER       Optional transition function invoked when the state is
+ *                     entered.
+ * \param  EXIT        Optional transition function invoked when the state is
+ *                     exited.
+ * \param  LOOP        Optional function invoked by MachineLoop while this
+ *                     state or one of its children has focus.
+ * \param  EVENTS      TINKER_EVENTS(table) or TINKER_NO_EVENTS. See
+ *                     StateHandleEvent.
+ * \param  POWER       TINKER_POWER(sleep, peripherals) or TINKER_ANY_POWER.
+ *                     See StatePower.
+ * \param  USERDATA    Opaque pointer returned by StateGetUserData.
+ */
+#define TINKER_STATE(NAME, PARENT, ENTER, EXIT, LOOP, EVENTS, POWER, USERDATA) \
+    static const StateDescriptor _##NAME##Descriptor TINKER_PROGMEM = { (PARENT), (ENTER), (EXIT), (LOOP), EVENTS, POWER, (USERDATA) }; \
+    State NAME = { &_##NAME##Descriptor, 0, STATE_INDEX_NONE }
+
+/**
+ * Use a table of StateEventFunc declared TINKER_PROGMEM and indexed by event
+ * as the EVENTS of a TINKER_STATE. Designated initializers keep it readable:
+ *
+ *     static const StateEventFunc _events[] TINKER_PROGMEM = {
+ *         [MY_EVENT_CLICK] = OnClick,
+ *     };
+ */
+#define TINKER_EVENTS(TABLE) (TABLE), (sizeof(TABLE) / sizeof((TABLE)[0]))
 
 /**
- * Objective-C like State object initializer.
- * \param  newState      The state object to initialize.
- * \param  parentState   The parent state in the state hierarchy. Should not be NULL
- *                       (Root State must be initialized using \link StateInitWSubstates \endlink).
- * \param  enter         An optional transition function invoked when this state
- *                       is entered.
- * \param  exit          An optional transition function invoked when this state
- *                       is exited.
- * \param  onLoop        An optional function to be invoked when this state is entered by a
- *                       run loop.
- * \return A pointer to the initialized state object.
+ * EVENTS for a TINKER_STATE that handles none. Events bubble straight through.
  */
-State* StateInit(State* newState, State* parentState, StateTransitionFunc enter, StateTransitionFunc exit, StateFunc onLoop);
+#define TINKER_NO_EVENTS 0, 0
+
+/**
+ * POWER for a TINKER_STATE. The deepest sleep the state allows and the
+ * peripherals it needs clocked.
+ */
+#define TINKER_POWER(SLEEP, PERIPHERALS) { (SLEEP), (PERIPHERALS) }
+
+/**
+ * POWER for a TINKER_STATE that puts no limits on sleep and needs no
+ * peripherals. Its parents may still have some.
+ */
+#define TINKER_ANY_POWER TINKER_POWER(STATE_SLEEP_DEEPEST, 0)
+
+// +--------------------------------------------------------------------------+
+// | STATE METHODS
+// +--------------------------------------------------------------------------+
 
 /**
- * Objective-C like State object initializer.
- * \param  newState      The state object to initialize.
- * \param  parentState   The parent state in the state hierarchy. May be 0 for the
- *                       root state.
- * \param  enter         An optional transition function invoked when this state
- *                       is entered.
- * \param  exit          An optional transition function invoked when this state
- *                       is exited.
- * \param  onLoop        An optional function to be invoked when this state is entered by a
- *                       run loop.
- * \param  substates     An array of states that are the newState's children.
- * \param  substateCount The number of states in the substates array.
- * \return A pointer to the initialized state object.
+ * \return The userData the state was declared with.
  */
-State* StateInitWSubstates(State* newState, State* parentState, StateTransitionFunc enter, StateTransitionFunc exit, StateFunc onLoop, State* substates[], size_t substateCount);
+void* StateGetUserData(State* state);
 
 /**
- * State de-initializer. This method may de-allocate internal data but will
- * not free the State pointer (i.e. this is a destructor not a deleter).
+ * \return The parent of a state or 0 for the root state.
  */
-void StateDestructor(State* state);
+State* GetParentState(State* state);
 
 /**
  * Query a state to discover it is currently entered. Remember that this state is
@@ -162,16 +218,17 @@ bool StateIsEntered(State* state);
 bool IsRootState(State* state);
 
 /**
- * Provide a state with an opportunity to process an interrupt.
- * \param  state            The state to invoke an interrupt handler on.
- * \param  interruptType    These are not yet well factored. Currently the only
- *                          valid value is STATE_INT_BUTTON_CLICK.
+ * Provide a single state with an opportunity to process an event. The handler
+ * is found by indexing the state's event table; parents are not consulted.
+ * Use \link DispatchMachineEvent \endlink to let events bubble.
+ * \param  state    The state to invoke an event handler on.
+ * \param  event    The event to handle.
  * \return If this method returns STATE_ERROR_FALSE the state declined to handle
- *         the interrupt (possibly because it did not have an interrupt handler).
- *         STATE_ERROR_NONE is returned to indicate the interrupt has been handled and
+ *         the event (possibly because it did not have a handler for it).
+ *         STATE_ERROR_NONE is returned to indicate the event has been handled and
  *         another STATE_ERROR_XXXX is returned to indicate the state tried but failed
- *         to handle the interrupt.
+ *         to handle the event.
  */
-StateErrorType StateHandleInterrupt(State* state, StateInterruptType interruptType);
+StateErrorType StateHandleEvent(State* state, StateEventType event);
 
 #endif /* STATE_H_ */
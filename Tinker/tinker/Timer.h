@@ -0,0 +1,167 @@
+/*
+Copyright 2016 Scott A Dixon
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include "tinker/RunLoop.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+struct _TimerType;
+
+/**
+ * Function type for timer callbacks.
+ * \param timer     The timer that expired.
+ */
+typedef void (*OnTimerFunc)(struct _TimerType* timer);
+
+/**
+ * Timer source function that reports how much time has passed.
+ * \return Milliseconds elapsed since the previous call. Sources must carry any
+ *         fraction of a millisecond over to the next call so time never drifts.
+ */
+typedef uint16_t (*TimerSourceElapsedFunc)(void);
+
+/**
+ * Timer source function that programs the next hardware deadline.
+ * \param  millis   Milliseconds after the last \link TimerSourceElapsedFunc \endlink
+ *                  call at which the source must call \link TimerServiceAlarm \endlink.
+ *                  0 means nothing is scheduled and the source may stop.
+ *                  A deadline already passed must raise the alarm as soon as
+ *                  possible. Also called from TimerServiceAlarm, so it must be
+ *                  safe from the timer source's interrupt.
+ */
+typedef void (*TimerSourceArmFunc)(uint16_t millis);
+
+/**
+ * \struct Timer
+ *
+ * A one-shot or periodic timer.
+ */
+typedef struct _TimerType
+{
+    /**
+     * Opaque pointer available for external use.
+     * This pointer is neither read nor written by the
+     * Timer and TimerService objects.
+     */
+    void* userData;
+    struct _TimerType* _next;
+    uint16_t _delta;
+    uint16_t _period;
+    OnTimerFunc _onTimer;
+    uint8_t _isScheduled;
+} Timer;
+
+/**
+ * \struct TimerService
+ *
+ * Tickless timer service. Scheduled timers are kept in a list sorted by
+ * deadline, each storing its delay relative to the timer before it, so only
+ * the head has to be looked at to program the next hardware deadline. The
+ * timer source interrupts once when that deadline passes and callbacks are
+ * then run from a runloop port, never from the interrupt. Periodic timers are
+ * rescheduled from their deadline, not from when they were dispatched, so
+ * runloop latency doesn't accumulate.
+ */
+typedef struct _TimerServiceType
+{
+    Timer* _head;
+    /**
+     * Timers past their deadline waiting for the port to dispatch them, in
+     * the order they expired. Their _delta is how late they are.
+     */
+    Timer* _expired;
+    TimerSourceElapsedFunc _elapsed;
+    TimerSourceArmFunc _arm;
+    RunLoop* _runLoop;
+    RunLoopPort _port;
+} TimerService;
+
+/**
+ * Objective-C style timer object initializer.
+ * \param timer     The timer instance to initialize.
+ * \param handler   The function to invoke when the timer expires.
+ * \return A pointer to the initialized timer instance.
+ */
+Timer* TimerInit(Timer* timer, OnTimerFunc handler);
+
+/**
+ * Objective-C style timer service object initializer.
+ * \param service   The timer service instance to initialize.
+ * \param runLoop   The runloop timer callbacks are dispatched from.
+ * \param elapsed   Time keeping function for the hardware timer source.
+ * \param arm       Deadline programming function for the hardware timer source.
+ * \return A pointer to the initialized service or 0 if a port could not be
+ *         added to the runloop.
+ */
+TimerService* TimerServiceInit(TimerService* service, RunLoop* runLoop, TimerSourceElapsedFunc elapsed, TimerSourceArmFunc arm);
+
+/**
+ * (Re)schedule a timer. Must not be called from an interrupt.
+ * \param service       The service to schedule the timer with.
+ * \param timer         The timer to schedule. If it was already scheduled it
+ *                      is rescheduled.
+ * \param delayMillis   Milliseconds from now until the timer first expires.
+ * \param periodMillis  Milliseconds between subsequent expirations or 0 for a
+ *                      one-shot timer.
+ */
+void ScheduleTimer(TimerService* service, Timer* timer, uint16_t delayMillis, uint16_t periodMillis);
+
+/**
+ * Unschedule a timer. Does nothing if the timer was not scheduled. Must not be
+ * called from an interrupt.
+ * \param service   The service the timer was scheduled with.
+ * \param timer     The timer to cancel.
+ */
+void CancelTimer(TimerService* service, Timer* timer);
+
+/**
+ * Query a timer to discover if it is scheduled.
+ * \param timer     The timer to query.
+ * \return true if the timer will expire in the future.
+ */
+bool IsTimerScheduled(Timer* timer);
+
+/**
+ * Query how long until a timer expires. Must not be called from an interrupt.
+ * \param service   The service the timer was scheduled with.
+ * \param timer     The timer to query.
+ * \return Milliseconds until the timer expires or 0 if it is due or not
+ *         scheduled.
+ */
+uint16_t GetTimerRemaining(TimerService* service, Timer* timer);
+
+/**
+ * Query a service to discover if any timers are scheduled.
+ * \param service   The service to query.
+ * \return true if at least one timer is scheduled.
+ */
+bool HasScheduledTimers(TimerService* service);
+
+/**
+ * Called by the timer source when the armed deadline has passed. Only posts to
+ * the service's runloop so this is safe (and intended) to call from an interrupt.
+ * If the runloop's queue is full the source is re-armed for 1ms to try again.
+ * \param service   The service whose deadline passed.
+ */
+void TimerServiceAlarm(TimerService* service);
+
+// TODO: Wart. Find a dynamic way to assign runloop message ids.
+#define RUNLOOP_MESSAGE_TIMER 2
+
+#endif /* TIMER_H_ */